@@ -0,0 +1,108 @@
+#include "../core/sharded_engine.hpp"
+#include "../core/tsc_clock.hpp"
+
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <algorithm>
+
+using Book = OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink>;
+
+// the order flow of bench_order_book, spread over n_instruments with ids unique per instrument
+std::vector<Event> make_events (size_t n_events, uint32_t n_instruments, uint32_t first_instrument, uint32_t stride, long unsigned int seed) {
+    std::vector<Event> events(n_events);
+    std::vector<OrderId> next_oid(n_instruments, 0);
+
+    std::mt19937_64 rd{seed};
+    std::uniform_real_distribution<float> type_sampler(0.0, 1.0);
+    std::normal_distribution price_sampler{100.f, 5.f};
+    std::uniform_int_distribution qty_sampler(1, 100);
+    std::uniform_int_distribution side_sampler(1, 2);
+    std::uniform_int_distribution<uint32_t> instrument_sampler(0, n_instruments - 1);
+
+    for (size_t i = 0; i < n_events; i++) {
+        Event& e = events[i];
+        uint32_t k = instrument_sampler(rd);
+        e.instrument = first_instrument + k * stride;
+        e.seq = i;
+        e.type = (next_oid[k] == 0 || type_sampler(rd) <= 0.8f) ? Type::New : Type::Cancel;
+        if (e.type == Type::Cancel) e.order_id = std::uniform_int_distribution<OrderId>(0, next_oid[k])(rd);
+        else e.order_id = next_oid[k]++;
+        e.side = side_sampler(rd) == 1 ? Side::Buy : Side::Sell;
+        e.price = std::round(price_sampler(rd));
+        e.quantity = qty_sampler(rd);
+    }
+    return events;
+}
+
+// one producer per shard feeding that shard's instruments, events are generated up front so
+// the producers are not the bottleneck
+void run_engine (size_t n_shards, uint32_t n_instruments, size_t n_events, const TscClock& clock, int first_core) {
+    EngineConfig config;
+    config.n_shards = n_shards;
+    config.n_producers = n_shards;
+    for (size_t s = 0; s < n_shards; s++) config.cores.push_back(first_core + static_cast<int>(s));
+
+    BookConfig book_config;
+    book_config.ladder = {64, 128};
+    book_config.order_capacity = 1 << 12;
+
+    ShardedEngine<Book> engine(config, clock);
+    // fewer instruments than shards still gives every producer one instrument, see make_events
+    for (uint32_t i = 0; i < std::max<uint32_t>(n_instruments, n_shards); i++) engine.add_instrument(i, book_config);
+
+    std::vector<std::vector<Event>> flows;
+    for (size_t p = 0; p < n_shards; p++) {
+        flows.push_back(make_events(n_events / n_shards, std::max<uint32_t>(1, n_instruments / n_shards), p, n_shards, p));
+    }
+
+    engine.start();
+    std::chrono::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < n_shards; p++) {
+        producers.emplace_back([&, p](){
+            for (Event e : flows[p]) {
+                e.timestamp_in = clock.now();
+                engine.submit(p, e);
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+    engine.stop();
+
+    std::chrono::time_point end = std::chrono::steady_clock::now();
+    auto time_taken_ms = std::max<long>(1, std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+
+    uint64_t processed {0};
+    uint64_t dropped {0};
+    size_t pinned {0};
+    for (size_t s = 0; s < n_shards; s++) {
+        processed += engine.processed(s);
+        dropped += engine.dropped(s);
+        pinned += engine.pinned(s);
+    }
+    LatencyHistogram lats;
+    engine.latency(lats);
+
+    std::cout << "== " << n_shards << " shards, " << n_instruments << " instruments, " << pinned << " pinned\n"
+    << "latencies (ns) p50: " << lats.percentile(50) << " | p99: " << lats.percentile(99) << " | max: " << lats.max() << "\n"
+    << processed << " events (" << dropped << " dropped), " << time_taken_ms << " ms, " << processed/time_taken_ms << " events/ms\n";
+}
+
+int main(int argc, char** argv) {
+    const size_t n_events = argc > 1 ? std::stoul(argv[1]) : 1<<22;
+    const uint32_t n_instruments = argc > 2 ? std::stoul(argv[2]) : 256;
+    // shard threads go on cores first_core, first_core + 1, ..., producers float
+    const int first_core = argc > 3 ? std::stoi(argv[3]) : 0;
+    const size_t max_shards = std::max(1u, std::thread::hardware_concurrency() / 2);
+
+    const TscClock clock;
+    for (size_t n_shards = 1; n_shards <= max_shards; n_shards *= 2) {
+        run_engine(n_shards, n_instruments, n_events, clock, first_core);
+    }
+
+    return 0;
+}
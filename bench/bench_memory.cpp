@@ -0,0 +1,196 @@
+#include "../core/order_book.hpp"
+#include "../core/spsc_ring.hpp"
+#include "../core/tsc_clock.hpp"
+#include "../core/page_allocator.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// data TLB load misses of the calling thread, reads -1 if perf events are not available
+class DtlbMissCounter {
+    int m_fd;
+
+    public:
+
+    DtlbMissCounter() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~DtlbMissCounter() { if (m_fd >= 0) ::close(m_fd); }
+
+    void start() {
+        if (m_fd < 0) return;
+        ::ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    long long stop() {
+        if (m_fd < 0) return -1;
+        ::ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count;
+        return ::read(m_fd, &count, sizeof(count)) == sizeof(count) ? count : -1;
+    }
+};
+
+// single threaded push then match, so the numbers are the memory system's and not the scheduler's
+// first event: push, pop and match of the very first event through the fresh ring and book
+void run_policy (const char* name, const MemoryPolicy& memory, const TscClock& clock, size_t n_events) {
+    constexpr size_t ring_capacity = 1 << 20;
+    constexpr size_t order_capacity = 1 << 20;
+
+    BookConfig config;
+    config.ladder = {64, 128};
+    config.ladder.memory = memory;
+    config.order_capacity = order_capacity;
+    config.memory = memory;
+
+    uint64_t build_start = clock.now();
+    SpscRing<Event> ring(ring_capacity, memory);
+    OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink> book(config);
+    uint64_t build_ns = clock.now() - build_start;
+
+    std::mt19937_64 rd{0};
+    std::normal_distribution price_sampler{100.f, 5.f};
+    std::uniform_int_distribution qty_sampler(1, 100);
+    auto next_event = [&](size_t i) {
+        Event e {};
+        e.seq = i;
+        e.type = Type::New;
+        e.order_id = i;
+        e.side = rd() & 1 ? Side::Buy : Side::Sell;
+        e.price = std::round(price_sampler(rd));
+        e.quantity = qty_sampler(rd);
+        return e;
+    };
+
+    uint64_t first_start = clock.now();
+    if (!ring.try_push(next_event(0))) throw std::logic_error("bench_memory: ring full");
+    std::span<Event> first = ring.peek_n(1);
+    book.on_batch(first, clock.now());
+    ring.release(1);
+    uint64_t first_ns = clock.now() - first_start;
+
+    // walk the whole ring a few times in batches, the book keeps a deep resting side
+    LatencyHistogram lats;
+    DtlbMissCounter tlb;
+    tlb.start();
+    for (size_t i = 1; i < n_events;) {
+        size_t n = std::min<size_t>(256, n_events - i);
+        uint64_t t0 = clock.now();
+        for (size_t j = 0; j < n; j++) {
+            if (!ring.try_push(next_event(i + j))) throw std::logic_error("bench_memory: ring smaller than a batch");
+        }
+        // peek_n stops at the ring's wrap point, so the n events can take two pieces
+        for (size_t done = 0; done < n;) {
+            std::span<Event> batch = ring.peek_n(n - done);
+            book.on_batch(batch, t0);
+            ring.release(batch.size());
+            done += batch.size();
+        }
+        lats.record((clock.now() - t0) / n);
+        i += n;
+    }
+    long long misses = tlb.stop();
+
+    std::cout << "== " << name << "\n"
+    << "build " << build_ns / 1000 << " us | first event " << first_ns << " ns\n"
+    << "per event (ns) p50: " << lats.percentile(50) << " | p99: " << lats.percentile(99) << " | max: " << lats.max() << "\n"
+    << "dTLB load misses: ";
+    if (misses < 0) std::cout << "n/a (perf events unavailable)\n";
+    else std::cout << misses << " (" << static_cast<double>(misses) / n_events << " per event)\n";
+}
+
+void print_memory_stats (const BookMemoryStats& m) {
+    std::cout << "orders live: " << m.live_orders << " | dead slots: " << m.dead_slots << " | free slots: " << m.free_slots
+    << " | levels: " << m.levels << "\n"
+    << "KiB pool: " << m.pool_bytes / 1024 << " | index: " << m.index_bytes / 1024 << " | ladders: " << m.ladder_bytes / 1024
+    << " | queues: " << m.queue_bytes / 1024 << " | timers: " << m.timer_bytes / 1024 << " | owners: " << m.owner_bytes / 1024
+    << " | total: " << m.total_bytes() / 1024 << "\n";
+}
+
+// long cancel heavy session on a few deep levels away from the touch, the live set stays
+// roughly flat, so anything that grows with the session is a leak
+template <class Book>
+void run_cancel_heavy (const char* name, Book& book, size_t n_events) {
+    std::mt19937_64 rd{0};
+    std::vector<OrderId> live;
+    BookMemoryStats peak;
+
+    for (size_t i = 0; i < n_events; i++) {
+        Event e {};
+        e.seq = i;
+        if (live.size() < 1024 || rd() % 2) {
+            e.type = Type::New;
+            e.order_id = i;
+            e.side = rd() & 1 ? Side::Buy : Side::Sell;
+            e.price = e.side == Side::Buy ? 90 + rd() % 4 : 106 + rd() % 4;
+            e.quantity = 1 + rd() % 100;
+            live.push_back(i);
+        }
+        else {
+            e.type = Type::Cancel;
+            size_t k = rd() % live.size();
+            e.order_id = live[k];
+            live[k] = live.back();
+            live.pop_back();
+        }
+        book.on_batch(std::span<const Event>(&e, 1), 0);
+
+        // preallocated structures keep total bytes flat, so the peak is the most slots held
+        if (i % 4096 == 0) {
+            BookMemoryStats m = book.memory_stats();
+            if (m.live_orders + m.dead_slots > peak.live_orders + peak.dead_slots) peak = m;
+        }
+    }
+
+    std::cout << "== " << name << ", " << n_events << " events, cancel heavy\nat the end\n";
+    print_memory_stats(book.memory_stats());
+    std::cout << "at the peak\n";
+    print_memory_stats(peak);
+}
+
+int main(int argc, char** argv) {
+    const size_t n_events = argc > 1 ? std::stoul(argv[1]) : 1<<22;
+    const TscClock clock;
+
+    MemoryPolicy mapped;
+    mapped.huge_pages = true;
+    mapped.prefault = true;
+    mapped.lock = true;
+    mapped.numa_node = current_numa_node();
+
+    // report which parts of the policy this machine actually grants
+    PageMapping probe = map_pages(huge_page_size, mapped);
+    std::cout << "policy on this machine: " << (probe.huge ? "hugetlb pages" : probe.thp ? "THP hint" : "4k pages")
+    << ", " << (probe.bound ? "bound to node " + std::to_string(mapped.numa_node) : std::string("unbound"))
+    << ", " << (probe.locked ? "locked" : "not locked") << "\n";
+    unmap_pages(probe.addr, huge_page_size, mapped);
+
+    run_policy("heap", MemoryPolicy{}, clock, n_events);
+    run_policy("huge pages, prefaulted, locked, node local", mapped, clock, n_events);
+
+    const BookConfig config {{64, 128}};
+    OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink> node_book(config);
+    run_cancel_heavy("node pool", node_book, n_events);
+    OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink, NullDepthSink, SweepOrderPool> sweep_book(config);
+    run_cancel_heavy("sweep pool", sweep_book, n_events);
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <string>
+#include "../core/latency_histogram.hpp"
+#include "../core/mpsc_ring.hpp"
+#include "../core/spsc_ring.hpp"
+#include "../core/tsc_clock.hpp"
+
+struct Timestamp {
+    uint64_t t;
+};
+
+// what we would do without an MPSC ring: one SpscRing with the producers serialised on a mutex
+template<class T>
+class LockedSpscRing {
+    SpscRing<T> m_ring;
+    std::mutex m_mutex;
+
+    public:
+
+    explicit LockedSpscRing(size_t capacity): m_ring(capacity) {}
+
+    bool try_push(const T& x) {
+        std::lock_guard lock(m_mutex);
+        return m_ring.try_push(x);
+    }
+
+    bool try_pop(T& out) { return m_ring.try_pop(out); }
+};
+
+// n_producers threads push n_ops between them, one consumer pops them all
+// reports throughput and the push to pop latency
+template<template<class> class Ring>
+void test_contention(const TscClock& clock, const size_t n_producers, const size_t n_ops) {
+    Ring<Timestamp> q(1<<10);
+    std::atomic<size_t> producers_done{0};
+    LatencyHistogram latencies;
+    size_t pop_count = 0;
+
+    std::thread consumer([&](){
+        Timestamp local_out;
+        size_t local_pop_count = 0;
+
+        while (producers_done.load(std::memory_order_acquire) < n_producers) {
+            if (q.try_pop(local_out)) {
+                uint64_t now = clock.now();
+                latencies.record(now > local_out.t ? now - local_out.t : 0);
+                local_pop_count += 1;
+            }
+        }
+
+        while (q.try_pop(local_out)) {
+            uint64_t now = clock.now();
+            latencies.record(now > local_out.t ? now - local_out.t : 0);
+            local_pop_count += 1;
+        }
+
+        pop_count = local_pop_count;
+    });
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < n_producers; p++) {
+        producers.emplace_back([&, p](){
+            size_t my_ops = n_ops / n_producers + (p < n_ops % n_producers);
+            for (size_t i = 0; i < my_ops; i++) {
+                Timestamp ts {clock.now()};
+                while (!q.try_push(ts)) {}
+            }
+            producers_done.fetch_add(1, std::memory_order_release);
+        });
+    }
+    for (auto& t : producers) t.join();
+    consumer.join();
+
+    auto end = std::chrono::steady_clock::now();
+    double time_taken = std::chrono::duration<double>(end - start).count();
+
+    std::cout << n_producers << " producers | n pops: " << pop_count << " | time: " << time_taken << "s" << " | ops/s: " << (pop_count/time_taken)
+    << " | latency (ns) p50: " << latencies.percentile(50)
+    << " p99: " << latencies.percentile(99)
+    << " max: " << latencies.max()
+    << std::endl;
+}
+
+template<template<class> class Ring>
+void run_contention_benches(const char* name, const TscClock& clock, const size_t n_ops) {
+    std::cout << "== " << name << std::endl;
+    for (size_t n_producers : {1, 2, 4, 8}) test_contention<Ring>(clock, n_producers, n_ops);
+}
+
+int main(int argc, char** argv) {
+    const size_t n_ops = argc > 1 ? std::stoul(argv[1]) : 1<<24;
+    const TscClock clock;
+
+    run_contention_benches<MpscRing>("MpscRing", clock, n_ops);
+    run_contention_benches<LockedSpscRing>("SpscRing behind a mutex", clock, n_ops);
+}
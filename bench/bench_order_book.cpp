@@ -1,6 +1,10 @@
 #include "../core/order_book.hpp"
 #include "../core/spsc_ring.hpp"
+#include "../core/tsc_clock.hpp"
+#include "../core/event_journal.hpp"
+#include "../core/broadcast_ring.hpp"
 
+#include <array>
 #include <chrono>
 #include <vector>
 #include <iostream>
@@ -8,6 +12,8 @@
 #include <thread>
 #include <atomic>
 #include <algorithm>
+#include <memory>
+#include <map>
 
 
 void log_trades (const std::vector<Trade> trades) {
@@ -18,99 +24,104 @@ void log_trades (const std::vector<Trade> trades) {
     std::cout << "\n\n";
 } 
 
-void bench_order_book (SpscRing<Event>& buffer, OrderBook& book, std::vector<Trade>& trades_out, BookStats& stats, size_t n_events = 1024, long unsigned int seed = 0) {
-    // shared data
-    trades_out.reserve(1024);
-    stats.latencies_ns.reserve(1024);
+// random order flow, mostly new orders priced around 100 and cancels of earlier ids
+class EventGenerator {
+    static constexpr float new_bar = 0.8f, cancel_bar = 1.0f;
+
+    int m_curr_oid {0};
+    std::mt19937_64 m_rd;
+    std::uniform_real_distribution<float> m_type_sampler {0.0, 1.0};
+    std::normal_distribution<float> m_price_sampler {100.f, 5.f};
+    std::uniform_int_distribution<int> m_qty_sampler {1, 100};
+    std::uniform_int_distribution<int> m_side_sampler {1, 2};
+
+    public:
+
+    explicit EventGenerator(long unsigned int seed): m_rd(seed) {}
+
+    void next(Event& e, size_t i, BookStats& stats) {
+        float type_rv = (i == 0) ? 0.0f : m_type_sampler(m_rd);
+        if (type_rv <= new_bar) {
+            e.type = Type::New;
+            stats.produced_new++;
+        }
+        else if (type_rv <= cancel_bar) {
+            e.type = Type::Cancel;
+            stats.produced_cancel++;
+        }
+        else {
+            e.type = Type::Replace;
+            stats.produced_replace++;
+        }
+        
+        e.seq = i;
+        if (e.type == Type::Cancel) {
+            std::uniform_int_distribution id_sampler(0, m_curr_oid);
+            e.order_id = id_sampler(m_rd);
+        }
+        else {
+            e.order_id = m_curr_oid++;
+        }
+        e.side = m_side_sampler(m_rd) == 1 ? Side::Buy : Side::Sell;
+        e.price = std::round(m_price_sampler(m_rd));
+        e.quantity = m_qty_sampler(m_rd);
+    }
+};
 
+template <class Ring, class Book>
+void bench_order_book (Ring& buffer, Book& book, BookStats& stats, const TscClock& clock, size_t n_events = 1024, long unsigned int seed = 0, EventJournal* journal = nullptr) {
+    // shared data
     std::atomic_bool finished_producing {false};
 
     std::thread consumer([&](){
-        while (!finished_producing.load(std::memory_order_acquire) || !buffer.empty()) {
-            // try pop and process events
-            Event e; 
-            if (buffer.try_pop(e)){
+        constexpr size_t batch_size = 64;
+        auto done = [&] { return finished_producing.load(std::memory_order_acquire); };
 
-                auto timestamp_out = std::chrono::steady_clock::now();
-                stats.latencies_ns.emplace_back(std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp_out - e.timestamp_in).count());
+        while (true) {
+            // idle per the ring's wait strategy, then read a batch of events in place and process them in one go
+            std::span<Event> batch = buffer.wait_n(batch_size, done);
+            if (batch.empty()) break;
 
-                stats.consumed++;
+            Timestamp timestamp_out = clock.now();
+            for (const Event& e : batch) {
+                stats.latency_ns.record(timestamp_out > e.timestamp_in ? timestamp_out - e.timestamp_in : 0);
 
-                // handle event with order book
                 switch (e.type)
                 {
-                case Type::New:
-                    book.on_new(e, trades_out);
-                    stats.consumed_new++;
-                    break;
-                case Type::Cancel:
-                    // std::cout << "cancelling " << e.order_id << " | "; 
-                    book -= (e.order_id);
-                    stats.consumed_cancel++;
-                    break;
-                case Type::Replace:
-                    // std::cout << "replacing " << e.order_id << " | "; 
-                    book.on_replace(e, trades_out);
-                    stats.consumed_replace++;
-                    break;
-                default:
-                    break;
+                case Type::New: stats.consumed_new++; break;
+                case Type::Cancel: stats.consumed_cancel++; break;
+                case Type::Replace: stats.consumed_replace++; break;
+                default: break;
                 }
             }
-            else {
-                std::this_thread::yield();
-            }
+            stats.consumed += batch.size();
+
+            // journal before matching so a replay sees exactly what the book saw
+            if (journal) journal->append(batch);
+
+            // handle events with order book
+            book.on_batch(batch, timestamp_out);
+            buffer.release(batch.size());
         }
     });
 
     std::thread producer([&](){
-        int curr_oid = 0;
-        
-        constexpr float new_bar = 0.8f, cancel_bar = 1.0f;
-        std::mt19937_64 rd{seed};
-        std::uniform_real_distribution<float> type_sampler(0.0, 1.0);
-        std::normal_distribution price_sampler{100.f, 5.f};
-        std::uniform_int_distribution qty_sampler(1, 100);
-        std::uniform_int_distribution side_sampler(1, 2);
-        
-
-        for (int i = 0; i < n_events; i++) {
+        EventGenerator generator(seed);
 
-            // randomly sample event
-            Event e;
-            
-            float type_rv = (i == 0) ? 0.0f : type_sampler(rd);
-            if (type_rv <= new_bar) {
-                e.type = Type::New;
-                stats.produced_new++;
-            }
-            else if (type_rv <= cancel_bar) {
-                e.type = Type::Cancel;
-                stats.produced_cancel++;
-            }
-            else {
-                e.type = Type::Replace;
-                stats.produced_replace++;
-            }
-            
-            e.seq = i;
-            if (e.type == Type::Cancel) {
-                std::uniform_int_distribution id_sampler(0, curr_oid);
-                e.order_id = id_sampler(rd);
-            }
-            else {
-                e.order_id = curr_oid++;
-            }
-            e.side = side_sampler(rd) == 1 ? Side::Buy : Side::Sell;
-            e.price = std::round(price_sampler(rd));
-            e.quantity = qty_sampler(rd);
-            e.timestamp_in = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n_events; i++) {
+            // randomly sample event straight into the ring slot
+            Event* slot;
+            while (!(slot = buffer.claim())) {};
+            Event& e = *new (slot) Event;
+            generator.next(e, i, stats);
+            e.timestamp_in = clock.now();
 
-            // add to buffer
-            while (!buffer.try_push(e)) {};
+            // make it visible to the consumer
+            buffer.publish();
             stats.produced++;
         }
         finished_producing.store(true, std::memory_order_release);
+        buffer.notify();
     });
 
     producer.join();
@@ -119,41 +130,336 @@ void bench_order_book (SpscRing<Event>& buffer, OrderBook& book, std::vector<Tra
     
 }
 
-int main() {
-    SpscRing<Event> buffer(1024);
-    OrderBook book;
+// same flow as a pipeline over one BroadcastRing, journal -> match -> stats, one thread per stage
+// every stage reads the same slots in place, the matching thread only matches
+template <class Book>
+void bench_pipeline (BroadcastRing<Event>& ring, Book& book, BookStats& stats, const TscClock& clock, size_t n_events = 1024, long unsigned int seed = 0, EventJournal* journal = nullptr) {
+    constexpr size_t batch_size = 64;
+
+    BroadcastConsumer<Event>& journal_stage = ring.add_consumer();
+    BroadcastConsumer<Event>& match_stage = ring.add_consumer({&journal_stage});
+    BroadcastConsumer<Event>& stats_stage = ring.add_consumer({&match_stage});
+
+    // runs f on each available batch until the stage has seen n_events
+    auto stage = [&](BroadcastConsumer<Event>& consumer, auto&& f) {
+        return std::thread([&consumer, f, n_events](){
+            for (size_t seen = 0; seen < n_events;) {
+                std::span<Event> batch = consumer.peek_n(batch_size);
+                if (batch.empty()) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                f(batch);
+                seen += batch.size();
+                consumer.release(batch.size());
+            }
+        });
+    };
+
+    std::thread journal_thread = stage(journal_stage, [&](std::span<Event> batch) {
+        if (journal) journal->append(batch);
+    });
+
+    std::thread match_thread = stage(match_stage, [&](std::span<Event> batch) {
+        book.on_batch(batch, clock.now());
+    });
+
+    // latency is measured after matching, so it covers the whole pipeline
+    std::thread stats_thread = stage(stats_stage, [&](std::span<Event> batch) {
+        Timestamp timestamp_out = clock.now();
+        for (const Event& e : batch) {
+            stats.latency_ns.record(timestamp_out > e.timestamp_in ? timestamp_out - e.timestamp_in : 0);
+
+            switch (e.type)
+            {
+            case Type::New: stats.consumed_new++; break;
+            case Type::Cancel: stats.consumed_cancel++; break;
+            case Type::Replace: stats.consumed_replace++; break;
+            default: break;
+            }
+        }
+        stats.consumed += batch.size();
+    });
+
+    std::thread producer([&](){
+        EventGenerator generator(seed);
+
+        for (size_t i = 0; i < n_events; i++) {
+            // slots are reused in place, overwrite every field
+            Event* slot;
+            while (!(slot = ring.claim())) {};
+            Event& e = *slot;
+            e = Event{};
+            generator.next(e, i, stats);
+            e.timestamp_in = clock.now();
+
+            ring.publish();
+            stats.produced++;
+        }
+    });
+
+    producer.join();
+    journal_thread.join();
+    match_thread.join();
+    stats_thread.join();
+}
+
+template <class Book>
+void run_bench (const char* name, Book& book, const TscClock& clock, const size_t n_events, EventJournal* journal = nullptr, bool pipelined = false) {
     BookStats stats;
-    std::vector<Trade> trades_out;
-    int n_events = 1<<22;
 
     std::chrono::time_point start = std::chrono::steady_clock::now();
 
-    bench_order_book(buffer, book, trades_out, stats, n_events, 0);
+    if (pipelined) {
+        BroadcastRing<Event> ring(1024);
+        bench_pipeline(ring, book, stats, clock, n_events, 0, journal);
+    }
+    else {
+        SpscRing<Event, false, YieldWait> buffer(1024);
+        bench_order_book(buffer, book, stats, clock, n_events, 0, journal);
+    }
 
     std::chrono::time_point end = std::chrono::steady_clock::now();
 
-    auto time_taken_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-    size_t n_trades = trades_out.size();
-    
-    auto percentile = [](const std::vector<uint64_t>& lats, const double p) {
-        return lats[static_cast<size_t>((p/100.0) * (lats.size() - 1))];
-    };
+    auto time_taken_ms = std::max<long>(1, std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+    size_t n_trades = book.sink().count();
 
     // book.log_books();
-    // log_trades(trades_out);
-
-    std::sort(stats.latencies_ns.begin(), stats.latencies_ns.end());
-    std::cout << "latencies (ns)\nmin:" << stats.latencies_ns.front() 
-    << " | p50: " << percentile(stats.latencies_ns, 50) 
-    << " | p95: " << percentile(stats.latencies_ns, 95) 
-    << " | p99: " << percentile(stats.latencies_ns, 99) 
-    << " | max: " << stats.latencies_ns.back()
+    // log_trades(book.sink().trades);  // with a VectorTradeSink
+
+    const LatencyHistogram& lats = stats.latency_ns;
+    std::cout << "== " << name << "\n";
+    std::cout << "latencies (ns)\nmin:" << lats.min() 
+    << " | p50: " << lats.percentile(50) 
+    << " | p95: " << lats.percentile(95) 
+    << " | p99: " << lats.percentile(99) 
+    << " | max: " << lats.max()
     << std::endl;
 
 
     std::cout << "throughput\n"
     << stats.produced << " events, " << time_taken_ms << " ms, " << n_events/time_taken_ms << " events/ms\n"
-    << n_trades << " trades, " << time_taken_ms << " ms, " << n_trades/time_taken_ms << " trades/ms\n";
+    << n_trades << " trades, " << time_taken_ms << " ms, " << n_trades/time_taken_ms << " trades/ms\n"
+    << "trade hash " << std::hex << book.sink().hash() << std::dec << "\n";
+}
+
+// count, quantity and id sum of the fills, order blind but one add per field, a hash chain
+// per fill would be most of what the deep sweep measures
+struct TallyTradeSink {
+    size_t count {0};
+    int64_t quantity {0};
+    uint64_t ids {0};
+
+    void begin() {}
+    void on_trade(const Trade& t) {
+        count++;
+        quantity += t.quantity;
+        ids += t.seller_id + t.buyer_id;
+    }
+    void on_trades(std::span<const Trade> ts) { for (const Trade& t : ts) on_trade(t); }
+};
+
+// deep levels: rest depth small makers on a few prices, then one aggressor sweeps most of them
+// single threaded and timed around the sweep only, reports ns per maker filled
+template <class Book>
+void bench_deep_sweep (const char* name, Book& book, const TscClock& clock, size_t depth, size_t rounds) {
+    constexpr Price first_price = 100;
+    constexpr uint32_t n_prices = 4;
+
+    std::mt19937_64 rd{0};
+    std::uniform_int_distribution qty_sampler(1, 10);
+    LatencyHistogram per_maker;
+    uint64_t seq {0}, makers {0}, sweep_ns {0};
+
+    for (size_t r = 0; r < rounds; r++) {
+        int64_t resting {0};
+        for (size_t i = 0; i < depth; i++) {
+            Event e {};
+            e.seq = seq;
+            e.type = Type::New;
+            e.order_id = seq++;
+            e.side = Side::Sell;
+            e.price = first_price + static_cast<Price>(i % n_prices);
+            e.quantity = qty_sampler(rd);
+            resting += e.quantity;
+            book.on_new(e, 0);
+        }
+
+        // three quarters of the resting quantity, so the sweep ends in a partial fill
+        Event sweep {};
+        sweep.seq = seq;
+        sweep.type = Type::New;
+        sweep.order_id = seq++;
+        sweep.side = Side::Buy;
+        sweep.price = first_price + n_prices;
+        sweep.quantity = static_cast<int32_t>(resting * 3 / 4);
+
+        size_t trades_before = book.sink().count;
+        uint64_t start = clock.now();
+        book.on_new(sweep, start);
+        uint64_t taken = clock.now() - start;
+        size_t filled = book.sink().count - trades_before;
+
+        sweep_ns += taken;
+        makers += filled;
+        per_maker.record(taken / std::max<size_t>(1, filled));
+
+        // clear the rest so every round starts from an empty book
+        Event sweep_rest = sweep;
+        sweep_rest.seq = seq;
+        sweep_rest.order_id = seq++;
+        sweep_rest.quantity = static_cast<int32_t>(resting);
+        sweep_rest.tif = TimeInForce::IOC;
+        book.on_new(sweep_rest, 0);
+    }
+
+    std::cout << "== " << name << ", " << depth << " makers over " << n_prices << " levels\n"
+    << "sweep ns per maker p50: " << per_maker.percentile(50) << " | p99: " << per_maker.percentile(99)
+    << " | mean: " << static_cast<double>(sweep_ns) / std::max<uint64_t>(1, makers) << "\n"
+    << "fills " << book.sink().count << " | quantity " << book.sink().quantity << " | id sum " << book.sink().ids << "\n";
+}
+
+// one session resting n_orders among as many of another, then pulled either as n_orders
+// cancel events or as one MassCancel event, single threaded and timed around on_batch only
+template <class Book>
+void bench_mass_cancel (const char* name, const TscClock& clock, const BookConfig& config, size_t n_orders) {
+    constexpr OwnerId session = 1, other = 2;
+
+    auto rest = [&](Book& book) {
+        std::mt19937_64 rd{0};
+        std::vector<OrderId> ids;
+        for (size_t i = 0; i < 2 * n_orders; i++) {
+            Event e {};
+            e.seq = i;
+            e.type = Type::New;
+            e.order_id = i;
+            e.side = i % 4 < 2 ? Side::Buy : Side::Sell;
+            e.price = e.side == Side::Buy ? 90 + rd() % 10 : 101 + rd() % 10;
+            e.quantity = 1 + rd() % 100;
+            e.owner = i % 2 ? other : session;
+            book.on_new(e, 0);
+            if (e.owner == session) ids.push_back(e.order_id);
+        }
+        return ids;
+    };
+
+    Book one_by_one(config);
+    std::vector<Event> cancels;
+    for (OrderId id : rest(one_by_one)) {
+        Event e {};
+        e.seq = 2 * n_orders + cancels.size();
+        e.type = Type::Cancel;
+        e.order_id = id;
+        cancels.push_back(e);
+    }
+    uint64_t start = clock.now();
+    size_t n_cancelled = one_by_one.on_batch(cancels, start);
+    uint64_t cancels_ns = clock.now() - start;
+
+    Book mass(config);
+    rest(mass);
+    Event e {};
+    e.seq = 2 * n_orders;
+    e.type = Type::MassCancel;
+    e.owner = session;
+    start = clock.now();
+    mass.on_batch(std::span<const Event>(&e, 1), start);
+    uint64_t mass_ns = clock.now() - start;
+
+    std::array<LevelDepth, 16> a, b;
+    bool same = true;
+    for (Side side : {Side::Buy, Side::Sell}) {
+        size_t n = one_by_one.top_n(side, a);
+        same &= n == mass.top_n(side, b);
+        for (size_t i = 0; same && i < n; i++) same &= a[i].price == b[i].price && a[i].quantity == b[i].quantity && a[i].orders == b[i].orders;
+    }
+
+    std::cout << "== " << name << ", pull " << n_orders << " of " << 2 * n_orders << " resting orders\n"
+    << n_cancelled << " cancel events: " << cancels_ns / 1000 << " us | one mass cancel: " << mass_ns / 1000 << " us"
+    << " | books " << (same ? "match" : "DIFFER") << "\n";
+}
+
+int main(int argc, char** argv) {
+    const size_t n_events = argc > 1 ? std::stoul(argv[1]) : 1<<22;
+    // optional journal of the first run, replay it with replay_journal
+    std::unique_ptr<EventJournal> journal;
+    if (argc > 2) journal = std::make_unique<EventJournal>(argv[2]);
+
+    // prices are sampled around 100, so a 128 tick band covers nearly all of them
+    const LadderConfig ladder {64, 128};
+    const TscClock clock;
+
+    OrderBook<MapLadder, StdOrderIndex, HashingTradeSink> map_book;
+    run_bench("map ladder, unordered_map index", map_book, clock, n_events, journal.get());
+    journal.reset();
+
+    OrderBook<FlatLadder, StdOrderIndex, HashingTradeSink> flat_book({ladder});
+    run_bench("flat ladder, unordered_map index", flat_book, clock, n_events);
+
+    OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink> probe_book({ladder});
+    run_bench("flat ladder, linear probe index", probe_book, clock, n_events);
+
+    OrderBook<FlatLadder, WindowIndex, HashingTradeSink> window_book({ladder});
+    run_bench("flat ladder, window index", window_book, clock, n_events);
+
+    OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink, NullDepthSink, SoaOrderPool> soa_book({ladder});
+    run_bench("flat ladder, linear probe index, struct of arrays pool", soa_book, clock, n_events);
+
+    OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink, NullDepthSink, SweepOrderPool> sweep_book({ladder});
+    run_bench("flat ladder, linear probe index, sweep pool", sweep_book, clock, n_events);
+
+    OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink> pipeline_book({ladder});
+    run_bench("flat ladder, linear probe index, journal -> match -> stats pipeline", pipeline_book, clock, n_events, nullptr, true);
+
+    // same book publishing L2 deltas to a publisher thread that keeps its own depth view
+    SpscRing<LevelDelta> deltas(1 << 16);
+    std::atomic_bool publishing {true};
+    size_t n_deltas {0}, n_levels {0};
+    std::thread publisher([&](){
+        std::map<std::pair<Side, Price>, int64_t> depth;
+        while (publishing.load(std::memory_order_acquire) || !deltas.empty()) {
+            std::span<LevelDelta> batch = deltas.peek_n(256);
+            if (batch.empty()) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (const LevelDelta& d : batch) {
+                if (d.orders) depth[{d.side, d.price}] = d.quantity;
+                else depth.erase({d.side, d.price});
+            }
+            n_deltas += batch.size();
+            deltas.release(batch.size());
+        }
+        n_levels = depth.size();
+    });
+
+    OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink, RingDepthSink<>> l2_book({ladder}, {}, RingDepthSink<>(deltas));
+    run_bench("flat ladder, linear probe index, L2 deltas", l2_book, clock, n_events);
+    publishing.store(false, std::memory_order_release);
+    publisher.join();
+    std::cout << n_deltas << " deltas, " << n_levels << " levels at the end\n";
+
+    // a session disconnect, per order cancels against one mass cancel
+    for (size_t n_orders : {1024, 16384}) {
+        const BookConfig config {ladder, 4 * n_orders};
+        bench_mass_cancel<OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink>>("flat ladder, linear probe index", clock, config, n_orders);
+        bench_mass_cancel<OrderBook<MapLadder, StdOrderIndex, HashingTradeSink>>("map ladder, unordered_map index", clock, config, n_orders);
+    }
+
+    // deep levels, the sweep path per pool layout
+    for (size_t depth : {64, 1024, 16384}) {
+        const size_t rounds = std::max<size_t>(4, (1 << 20) / depth);
+        const BookConfig deep {ladder, 2 * depth};
+
+        OrderBook<FlatLadder, LinearProbeIndex, TallyTradeSink> node_deep(deep);
+        bench_deep_sweep("node pool", node_deep, clock, depth, rounds);
+
+        OrderBook<FlatLadder, LinearProbeIndex, TallyTradeSink, NullDepthSink, SoaOrderPool> soa_deep(deep);
+        bench_deep_sweep("struct of arrays pool", soa_deep, clock, depth, rounds);
+
+        OrderBook<FlatLadder, LinearProbeIndex, TallyTradeSink, NullDepthSink, SweepOrderPool> sweep_deep(deep);
+        bench_deep_sweep("sweep pool, contiguous quantities", sweep_deep, clock, depth, rounds);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
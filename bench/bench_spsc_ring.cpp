@@ -4,14 +4,19 @@
 #include <thread>
 #include <vector>
 #include <algorithm>
+#include <string>
+#include <span>
+#include <ctime>
+#include "../core/latency_histogram.hpp"
 #include "../core/spsc_ring.hpp"
+#include "../core/tsc_clock.hpp"
 
 struct Timestamp {
-    std::chrono::steady_clock::time_point t;
+    uint64_t t;
 };
 
-template<class T>
-void test_throughput(SpscRing<T>& q, const T& val, T& out, const size_t n_ops){
+template<class Ring, class T>
+void test_throughput(Ring& q, const T& val, T& out, const size_t n_ops){
     auto start = std::chrono::steady_clock::now();
     for(size_t i = 0; i < n_ops; i++) {
         while (!q.try_push(val)) {}
@@ -23,8 +28,8 @@ void test_throughput(SpscRing<T>& q, const T& val, T& out, const size_t n_ops){
     std::cout << "n operations: " << n_ops << " time: " << time_taken << "s" << " ops/s: " << (n_ops/time_taken) << std::endl;
 }
 
-template<class T>
-void test_minimal_concurrent_throughput(SpscRing<T>& q, const T& val, const size_t n_ops) {
+template<class Ring, class T>
+void test_minimal_concurrent_throughput(Ring& q, const T& val, const size_t n_ops) {
     std::atomic<bool> stop_flag{false};
     size_t pop_count = 0;
 
@@ -56,25 +61,109 @@ void test_minimal_concurrent_throughput(SpscRing<T>& q, const T& val, const size
 
 }
 
-void test_minimal_concurrent_latency(SpscRing<Timestamp>& q, const size_t n_ops) {
-    using clock = std::chrono::steady_clock;
+// same as above but moving batch_size items per index update on both sides
+template<size_t batch_size = 32, class Ring, class T>
+void test_batch_concurrent_throughput(Ring& q, const T& val, const size_t n_ops) {
+    std::atomic<bool> stop_flag{false};
+    size_t pop_count = 0;
+
+    std::thread consumer([&](){
+        T local_out[batch_size];
+        size_t local_pop_count = 0;
+
+        while(!stop_flag.load(std::memory_order_relaxed)) {
+            local_pop_count += q.try_pop_n(local_out, batch_size);
+        }
+
+        while (size_t n = q.try_pop_n(local_out, batch_size)) local_pop_count += n;
+
+        pop_count = local_pop_count;
+    });
+
+    T local_in[batch_size];
+    std::fill(local_in, local_in + batch_size, val);
+
+    auto start = std::chrono::steady_clock::now();
+    
+    for(size_t i = 0; i < n_ops;) {
+        i += q.try_push_n(local_in, std::min(batch_size, n_ops - i));
+    }
+    stop_flag.store(true, std::memory_order_relaxed);
+    consumer.join();
+
+    auto end = std::chrono::steady_clock::now();
+    double time_taken = std::chrono::duration<double>(end - start).count();
+    
+    std::cout << "batch " << batch_size << " | n pushes: " << n_ops << " | n pops: " << pop_count << " | time: " << time_taken << "s" << " | ops/s: " << (pop_count/time_taken) << std::endl;
+
+}
+
+// zero copy: producer constructs in the claimed slot, consumer reads in place before releasing
+template<class Ring, class T>
+void test_claim_concurrent_throughput(Ring& q, const T& val, const size_t n_ops) {
     std::atomic<bool> stop_flag{false};
-    std::vector<uint64_t> latencies;
-    latencies.reserve(n_ops);
+    size_t pop_count = 0;
+    T checksum {};
+
+    // summing what is read keeps the in place reads from being optimised away
+    std::thread consumer([&](){
+        T local_sum {};
+        size_t local_pop_count = 0;
+
+        while(!stop_flag.load(std::memory_order_relaxed)) {
+            if (T* slot = q.peek()) {
+                local_sum += *slot;
+                q.release();
+                local_pop_count += 1;
+            }
+        }
+
+        while (T* slot = q.peek()) {
+            local_sum += *slot;
+            q.release();
+            local_pop_count += 1;
+        }
+
+        pop_count = local_pop_count;
+        checksum = local_sum;
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    
+    for(size_t i = 0; i < n_ops; i++) {
+        T* slot;
+        while (!(slot = q.claim())) {}
+        new (slot) T(val);
+        q.publish();
+    }
+    stop_flag.store(true, std::memory_order_relaxed);
+    consumer.join();
+
+    auto end = std::chrono::steady_clock::now();
+    double time_taken = std::chrono::duration<double>(end - start).count();
+    
+    std::cout << "claim/peek | n pushes: " << n_ops << " | n pops: " << pop_count << " | time: " << time_taken << "s" << " | ops/s: " << (pop_count/time_taken) << " | checksum: " << checksum << std::endl;
+
+}
+
+template<class Ring>
+void test_minimal_concurrent_latency(Ring& q, const TscClock& clock, const size_t n_ops) {
+    std::atomic<bool> stop_flag{false};
+    LatencyHistogram latencies;
 
     std::thread consumer([&](){
         Timestamp local_out;
 
         while(!stop_flag.load(std::memory_order_relaxed)) {
             if (q.try_pop(local_out)) {
-                auto lat_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - local_out.t);
-                latencies.emplace_back(lat_ns.count());
+                uint64_t now = clock.now();
+                latencies.record(now > local_out.t ? now - local_out.t : 0);
             };
         }
 
         while (q.try_pop(local_out)) {
-            auto lat_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - local_out.t);
-            latencies.emplace_back(lat_ns.count());
+            uint64_t now = clock.now();
+            latencies.record(now > local_out.t ? now - local_out.t : 0);
         }
 
     });
@@ -82,33 +171,105 @@ void test_minimal_concurrent_latency(SpscRing<Timestamp>& q, const size_t n_ops)
     auto start = std::chrono::steady_clock::now();
     
     for(size_t i = 0; i < n_ops; i++) {
-        Timestamp ts {clock::now()};
+        Timestamp ts {clock.now()};
         while (!q.try_push(ts)) {}
     }
     stop_flag.store(true, std::memory_order_relaxed);
     consumer.join();
 
-    if (latencies.empty()) {
+    if (!latencies.count()) {
         std::cout << "no samples\n";
         return;
     }
 
-    std::sort(latencies.begin(), latencies.end());
-    auto percentile = [&](double p) {
-        return latencies[static_cast<size_t>((p/100.0) * (latencies.size() - 1))];
-    };
-    std::cout << "latencies (ns) - min:" << latencies.front() 
-    << " | p50: " << percentile(50) 
-    << " | p95: " << percentile(95) 
-    << " | p99: " << percentile(99) 
-    << " | max: " << latencies.back() 
+    std::cout << "latencies (ns) - min:" << latencies.min() 
+    << " | p50: " << latencies.percentile(50) 
+    << " | p95: " << latencies.percentile(95) 
+    << " | p99: " << latencies.percentile(99) 
+    << " | max: " << latencies.max() 
     << std::endl;
 }
 
-int main() {
-    SpscRing<Timestamp> q (1<<10);
-    // int x = 100, out;
-    const size_t n_ops = 1<<25;
-    test_minimal_concurrent_latency(q, n_ops);
+// cpu time of the calling thread
+inline double thread_cpu_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
 
+// producer sends one item every gap_ns, so the consumer spends most of its time waiting
+// reports the push to pop latency and how much of a core the waiting consumer burnt
+template<class Wait>
+void test_wait_strategy(const char* name, const TscClock& clock, const size_t n_ops, const uint64_t gap_ns) {
+    SpscRing<Timestamp, true, Wait> q(1<<10);
+    std::atomic<bool> stop_flag{false};
+    LatencyHistogram latencies;
+    double consumer_cpu = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread consumer([&](){
+        double cpu_start = thread_cpu_seconds();
+        auto done = [&] { return stop_flag.load(std::memory_order_acquire); };
+
+        while (true) {
+            std::span<Timestamp> batch = q.wait_n(64, done);
+            if (batch.empty()) break;
+            uint64_t now = clock.now();
+            for (const Timestamp& ts : batch) latencies.record(now > ts.t ? now - ts.t : 0);
+            q.release(batch.size());
+        }
+
+        consumer_cpu = thread_cpu_seconds() - cpu_start;
+    });
+
+    for(size_t i = 0; i < n_ops; i++) {
+        uint64_t due = clock.now() + gap_ns;
+        while (clock.now() < due) {}
+        Timestamp ts {clock.now()};
+        while (!q.try_push(ts)) {}
+    }
+    stop_flag.store(true, std::memory_order_release);
+    q.notify();
+    consumer.join();
+
+    double time_taken = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name << " | latencies (ns) - p50: " << latencies.percentile(50)
+    << " | p99: " << latencies.percentile(99)
+    << " | max: " << latencies.max()
+    << " | consumer cpu: " << static_cast<int>(100 * consumer_cpu / time_taken) << "%"
+    << std::endl;
+}
+
+template<template<class> class Ring>
+void run_ring_benches(const char* name, const TscClock& clock, const size_t n_ops) {
+    std::cout << "== " << name << std::endl;
+
+    Ring<Timestamp> q (1<<10);
+    test_minimal_concurrent_latency(q, clock, n_ops);
+
+    Ring<uint64_t> q_ops (1<<10);
+    test_minimal_concurrent_throughput(q_ops, uint64_t{1}, n_ops);
+    test_batch_concurrent_throughput(q_ops, uint64_t{1}, n_ops);
+    test_claim_concurrent_throughput(q_ops, uint64_t{1}, n_ops);
+}
+
+template<class T>
+using PlainSpscRing = SpscRing<T>;
+
+int main(int argc, char** argv) {
+    const size_t n_ops = argc > 1 ? std::stoul(argv[1]) : 1<<25;
+    const TscClock clock;
+
+    run_ring_benches<PlainSpscRing>("SpscRing", clock, n_ops);
+    run_ring_benches<CachedSpscRing>("CachedSpscRing", clock, n_ops);
+
+    // paced traffic, one item every 10us
+    const size_t n_paced = std::max<size_t>(1, n_ops >> 8);
+    std::cout << "== wait strategies, " << n_paced << " items 10us apart" << std::endl;
+    test_wait_strategy<BusySpinWait>("busy spin", clock, n_paced, 10'000);
+    test_wait_strategy<PauseSpinWait>("spin + pause", clock, n_paced, 10'000);
+    test_wait_strategy<YieldWait>("yield", clock, n_paced, 10'000);
+    test_wait_strategy<BackoffWait>("futex backoff", clock, n_paced, 10'000);
+}
@@ -0,0 +1,120 @@
+#include "../core/order_book.hpp"
+#include "../core/event_journal.hpp"
+#include "../core/book_snapshot.hpp"
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <string>
+
+// periodic snapshots taken while replaying
+struct SnapshotSchedule {
+    SnapshotWriter* writer {nullptr};
+    size_t every {0};
+};
+
+// replays a journal through one book as fast as it will go, returns the trade hash
+// restores from snapshot first and skips the events it already covers, if given
+template <class Book>
+uint64_t replay (const char* name, Book& book, std::span<const JournalRecord> records, const SnapshotReader* from, SnapshotSchedule schedule = {}) {
+    constexpr size_t batch_size = 256;
+    std::array<Event, batch_size> batch;
+    BookSnapshot capture;
+    size_t since_snapshot {0}, n_snapshots {0};
+    long max_pause_us {0};
+
+    std::chrono::time_point start = std::chrono::steady_clock::now();
+
+    if (from) {
+        book.restore(from->view());
+        // journal seqs are increasing, resume at the first event the snapshot does not cover
+        uint64_t next_seq = book.next_seq();
+        records = records.subspan(std::partition_point(records.begin(), records.end(),
+            [&](const JournalRecord& r) { return r.seq < next_seq; }) - records.begin());
+    }
+
+    for (size_t i = 0; i < records.size(); i += batch_size) {
+        size_t n = std::min(batch_size, records.size() - i);
+        for (size_t j = 0; j < n; j++) batch[j] = to_event(records[i + j]);
+        // the journaled arrival time stands in for the clock so reruns are deterministic, expiry
+        // follows each event's timestamp_in inside on_batch exactly as it did live
+        book.on_batch({batch.data(), n}, batch[n - 1].timestamp_in);
+
+        since_snapshot += n;
+        if (schedule.writer && since_snapshot >= schedule.every) {
+            // the matching thread only pays for the copy, a busy writer means try again next batch
+            std::chrono::time_point pause_start = std::chrono::steady_clock::now();
+            book.snapshot(capture);
+            if (schedule.writer->submit(capture)) {
+                since_snapshot = 0;
+                n_snapshots++;
+            }
+            long pause_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pause_start).count();
+            max_pause_us = std::max(max_pause_us, pause_us);
+        }
+    }
+
+    std::chrono::time_point end = std::chrono::steady_clock::now();
+
+    auto time_taken_ms = std::max<long>(1, std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+    const HashingTradeSink& sink = book.sink();
+
+    std::cout << "== " << name << "\n"
+    << records.size() << " events, " << time_taken_ms << " ms, " << records.size()/time_taken_ms << " events/ms\n"
+    << sink.count() << " trades, trade hash " << std::hex << sink.hash() << std::dec << "\n";
+    if (n_snapshots) std::cout << n_snapshots << " snapshots, longest capture " << max_pause_us << " us\n";
+    return sink.hash();
+}
+
+int main(int argc, char** argv) {
+    const char* usage = "usage: replay_journal <journal> [--from <snapshot>] [--snapshot-to <path> --every <events>]\n";
+    if (argc < 2) {
+        std::cerr << usage;
+        return 2;
+    }
+
+    std::unique_ptr<SnapshotReader> from;
+    std::unique_ptr<SnapshotWriter> writer;
+    size_t every = 1 << 16;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << usage;
+            return 2;
+        }
+        if (arg == "--from") from = std::make_unique<SnapshotReader>(argv[++i]);
+        else if (arg == "--snapshot-to") writer = std::make_unique<SnapshotWriter>(argv[++i]);
+        else if (arg == "--every") every = std::stoul(argv[++i]);
+        else {
+            std::cerr << usage;
+            return 2;
+        }
+    }
+
+    JournalReader journal(argv[1]);
+    std::span<const JournalRecord> records = journal.records();
+
+    // same band as bench_order_book
+    const LadderConfig ladder {64, 128};
+
+    OrderBook<MapLadder, StdOrderIndex, HashingTradeSink> map_book;
+    uint64_t expected = replay("map ladder, unordered_map index", map_book, records, from.get(), {writer.get(), every});
+    writer.reset();
+
+    OrderBook<FlatLadder, StdOrderIndex, HashingTradeSink> flat_book({ladder});
+    OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink> probe_book({ladder});
+    OrderBook<FlatLadder, WindowIndex, HashingTradeSink> window_book({ladder});
+    OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink, NullDepthSink, SoaOrderPool> soa_book({ladder});
+    OrderBook<FlatLadder, LinearProbeIndex, HashingTradeSink, NullDepthSink, SweepOrderPool> sweep_book({ladder});
+
+    bool match = replay("flat ladder, unordered_map index", flat_book, records, from.get()) == expected;
+    match &= replay("flat ladder, linear probe index", probe_book, records, from.get()) == expected;
+    match &= replay("flat ladder, window index", window_book, records, from.get()) == expected;
+    match &= replay("flat ladder, linear probe index, struct of arrays pool", soa_book, records, from.get()) == expected;
+    match &= replay("flat ladder, linear probe index, sweep pool", sweep_book, records, from.get()) == expected;
+
+    std::cout << (match ? "all backends match\n" : "trade hash MISMATCH\n");
+    return match ? 0 : 1;
+}
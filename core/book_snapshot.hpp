@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "file_io.hpp"
+#include "order_book_types.hpp"
+
+// file layout: header, sell levels best to worst then buy levels best to worst,
+// then every resting order grouped by those levels in FIFO order
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sell_levels;
+    uint32_t buy_levels;
+    uint32_t pad;
+    uint64_t orders;
+    uint64_t next_seq; // seq of the last applied event + 1, 0 if none
+};
+static_assert(sizeof(SnapshotHeader) == 40);
+
+struct SnapshotLevel {
+    Price price;
+    uint32_t orders;
+    int64_t quantity;
+};
+static_assert(sizeof(SnapshotLevel) == 16);
+
+struct SnapshotOrder {
+    OrderId order_id;
+    uint64_t seq_new;
+    uint64_t expire_time; // 0 if good till cancel
+    int32_t quantity_remaining;
+    OwnerId owner; // 0 if none
+};
+static_assert(sizeof(SnapshotOrder) == 32);
+
+inline constexpr char snapshot_magic[8] = {'D', 'C', 'K', 'S', 'N', 'A', 'P', '\0'};
+inline constexpr uint32_t snapshot_version = 2;
+
+// what OrderBook::restore reads, backed by a BookSnapshot or a mapped file
+struct SnapshotView {
+    uint64_t next_seq {0};
+    std::span<const SnapshotLevel> sell_levels;
+    std::span<const SnapshotLevel> buy_levels;
+    std::span<const SnapshotOrder> orders;
+};
+
+// in memory capture filled by OrderBook::snapshot, vectors keep their capacity between captures
+struct BookSnapshot {
+    uint64_t next_seq {0};
+    uint32_t sell_levels {0};
+    std::vector<SnapshotLevel> levels;
+    std::vector<SnapshotOrder> orders;
+
+    void clear() {
+        next_seq = 0;
+        sell_levels = 0;
+        levels.clear();
+        orders.clear();
+    }
+
+    SnapshotView view() const {
+        std::span<const SnapshotLevel> all(levels);
+        return {next_seq, all.first(sell_levels), all.subspan(sell_levels), orders};
+    }
+};
+
+// writes to path.tmp and renames over path, so readers only ever see a whole snapshot
+inline bool save_snapshot(const BookSnapshot& snap, const std::string& path) {
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    SnapshotHeader header {};
+    std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+    header.version = snapshot_version;
+    header.sell_levels = snap.sell_levels;
+    header.buy_levels = static_cast<uint32_t>(snap.levels.size() - snap.sell_levels);
+    header.orders = snap.orders.size();
+    header.next_seq = snap.next_seq;
+
+    bool ok = write_all(fd, &header, sizeof(header))
+        && write_all(fd, snap.levels.data(), snap.levels.size() * sizeof(SnapshotLevel))
+        && write_all(fd, snap.orders.data(), snap.orders.size() * sizeof(SnapshotOrder))
+        && ::fsync(fd) == 0;
+    ok &= ::close(fd) == 0;
+    return ok && ::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// saves snapshots on a background thread, the matching thread only pays for the capture
+// submit hands over a capture and gets the previously written one back to reuse
+class SnapshotWriter {
+    std::string m_path;
+    BookSnapshot m_pending;
+    std::atomic<bool> m_busy {false};
+    std::atomic<bool> m_stop {false};
+    std::atomic<uint64_t> m_saved {0};
+    std::atomic<uint64_t> m_failed {0};
+    std::thread m_thread;
+
+    void run() {
+        while (true) {
+            if (m_busy.load(std::memory_order_acquire)) {
+                if (save_snapshot(m_pending, m_path)) m_saved.fetch_add(1, std::memory_order_relaxed);
+                else m_failed.fetch_add(1, std::memory_order_relaxed);
+                m_busy.store(false, std::memory_order_release);
+            }
+            else if (m_stop.load(std::memory_order_acquire)) {
+                return;
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    public:
+
+    explicit SnapshotWriter(std::string path): m_path(std::move(path)), m_thread([this] { run(); }) {}
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // finishes a snapshot in flight
+    ~SnapshotWriter() {
+        m_stop.store(true, std::memory_order_release);
+        m_thread.join();
+    }
+
+    // never blocks, returns false and leaves snap alone if the last one is still being written
+    bool submit(BookSnapshot& snap) {
+        if (m_busy.load(std::memory_order_acquire)) return false;
+        std::swap(m_pending, snap);
+        m_busy.store(true, std::memory_order_release);
+        return true;
+    }
+
+    uint64_t saved() const { return m_saved.load(std::memory_order_relaxed); }
+    uint64_t failed() const { return m_failed.load(std::memory_order_relaxed); }
+};
+
+// read only memory map of a snapshot file
+class SnapshotReader {
+    MappedFile m_file;
+    SnapshotView m_view;
+
+    public:
+
+    explicit SnapshotReader(const std::string& path):
+    m_file(path, sizeof(SnapshotHeader), "SnapshotReader")
+    {
+        const auto* header = reinterpret_cast<const SnapshotHeader*>(m_file.data());
+        if (std::memcmp(header->magic, snapshot_magic, sizeof(snapshot_magic)) != 0 || header->version != snapshot_version) {
+            throw std::runtime_error("SnapshotReader: not a snapshot or wrong version " + path);
+        }
+        // counts are bounded by the file before multiplying, a corrupt header cannot wrap the check
+        size_t body = m_file.size() - sizeof(SnapshotHeader);
+        size_t n_levels = size_t{header->sell_levels} + header->buy_levels;
+        if (n_levels > body / sizeof(SnapshotLevel) || header->orders > (body - n_levels * sizeof(SnapshotLevel)) / sizeof(SnapshotOrder)
+            || body != n_levels * sizeof(SnapshotLevel) + header->orders * sizeof(SnapshotOrder)) {
+            throw std::runtime_error("SnapshotReader: size does not match header " + path);
+        }
+
+        const char* p = m_file.data() + sizeof(SnapshotHeader);
+        const auto* levels = reinterpret_cast<const SnapshotLevel*>(p);
+        const auto* orders = reinterpret_cast<const SnapshotOrder*>(p + n_levels * sizeof(SnapshotLevel));
+        m_view = {header->next_seq, {levels, header->sell_levels}, {levels + header->sell_levels, header->buy_levels}, {orders, header->orders}};
+    }
+
+    const SnapshotView& view() const { return m_view; }
+};
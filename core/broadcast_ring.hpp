@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <span>
+#include <vector>
+
+// published or consumed count, alone on its cache line
+struct alignas(64) Sequence {
+    std::atomic<size_t> value {0};
+
+    size_t load() const { return value.load(std::memory_order_acquire); }
+    void store(size_t v) { value.store(v, std::memory_order_release); }
+};
+
+template <class T>
+class BroadcastRing;
+
+// one stage reading a BroadcastRing, it sees every slot, in order, in place
+// a stage can read up to the slowest of its dependencies (the producer if it has none)
+template <class T>
+class BroadcastConsumer {
+    friend class BroadcastRing<T>;
+
+    BroadcastRing<T>& m_ring;
+    std::vector<const Sequence*> m_deps;
+    Sequence m_seq; // slots this stage has released
+    size_t m_available {0}; // cached min over m_deps, this stage only
+
+    BroadcastConsumer(BroadcastRing<T>& ring, std::vector<const Sequence*> deps):
+    m_ring(ring),
+    m_deps(std::move(deps))
+    {}
+
+    // readable slots, reloads the dependencies only if the cached bound gives fewer than wanted
+    size_t used_slots(size_t seq, size_t wanted) {
+        if (m_available - seq >= wanted) return m_available - seq;
+        size_t available = m_deps[0]->load();
+        for (size_t i = 1; i < m_deps.size(); i++) available = std::min(available, m_deps[i]->load());
+        m_available = available;
+        return available - seq;
+    }
+
+    public:
+
+    BroadcastConsumer(const BroadcastConsumer&) = delete;
+    BroadcastConsumer& operator=(const BroadcastConsumer&) = delete;
+
+    // oldest unread slot, nullptr if none is available yet
+    T* peek() {
+        size_t seq = m_seq.value.load(std::memory_order_relaxed);
+        if (!used_slots(seq, 1)) return nullptr;
+        return &m_ring.slot(seq);
+    }
+
+    // up to n available slots in place, stops early at the end of the buffer so the span is contiguous
+    // slots are shared with the other stages, a stage may only write the parts it owns
+    std::span<T> peek_n(size_t n) {
+        size_t seq = m_seq.value.load(std::memory_order_relaxed);
+        n = std::min({n, used_slots(seq, n), m_ring.capacity() - (seq & (m_ring.capacity() - 1))});
+        return {&m_ring.slot(seq), n};
+    }
+
+    // done with the n oldest slots, later stages and the producer may now have them
+    void release(size_t n = 1) {
+        m_seq.store(m_seq.value.load(std::memory_order_relaxed) + n);
+    }
+
+    // nothing left to read right now
+    bool empty() {
+        return used_slots(m_seq.value.load(std::memory_order_relaxed), 1) == 0;
+    }
+
+    const Sequence& sequence() const { return m_seq; }
+};
+
+// single producer, many consumers, every consumer sees every slot (disruptor style)
+// slots are constructed once up front and overwritten in place, nothing is copied per consumer
+// the producer may not lap the slowest consumer, consumers are added before any traffic
+template <class T>
+class BroadcastRing {
+    friend class BroadcastConsumer<T>;
+
+    const size_t m_capacity, m_mask;
+    std::unique_ptr<T[]> m_buffer;
+    std::vector<std::unique_ptr<BroadcastConsumer<T>>> m_consumers;
+
+    Sequence m_cursor; // slots published
+    alignas(64) size_t m_gate_cache {0}; // producer only, cached min over consumer sequences
+
+    T& slot(size_t seq) { return m_buffer[seq & m_mask]; }
+
+    // free slots seen by the producer, reloads the consumer sequences if fewer than wanted
+    size_t free_slots(size_t head, size_t wanted) {
+        if (m_capacity - (head - m_gate_cache) >= wanted) return m_capacity - (head - m_gate_cache);
+        size_t gate = head;
+        for (const auto& c : m_consumers) gate = std::min(gate, c->m_seq.load());
+        m_gate_cache = gate;
+        return m_capacity - (head - gate);
+    }
+
+    public:
+
+    // capacity must be a power of two
+    explicit BroadcastRing(size_t capacity):
+    m_capacity(capacity),
+    m_mask(capacity - 1),
+    m_buffer(std::make_unique<T[]>(capacity))
+    {}
+
+    // new stage reading after every stage in deps, or straight after the producer if deps is empty
+    BroadcastConsumer<T>& add_consumer(std::initializer_list<const BroadcastConsumer<T>*> deps = {}) {
+        std::vector<const Sequence*> seqs;
+        for (const BroadcastConsumer<T>* d : deps) seqs.push_back(&d->sequence());
+        if (seqs.empty()) seqs.push_back(&m_cursor);
+        m_consumers.push_back(std::unique_ptr<BroadcastConsumer<T>>(new BroadcastConsumer<T>(*this, std::move(seqs))));
+        return *m_consumers.back();
+    }
+
+    // next slot to fill, holding whatever was last written there, nullptr if the ring is full
+    T* claim() {
+        size_t head = m_cursor.value.load(std::memory_order_relaxed);
+        if (!free_slots(head, 1)) return nullptr;
+        return &slot(head);
+    }
+
+    // make the slot returned by the last claim() visible to the stages without dependencies
+    void publish() {
+        m_cursor.store(m_cursor.value.load(std::memory_order_relaxed) + 1);
+    }
+
+    // true once every stage has released everything published
+    bool drained() {
+        size_t head = m_cursor.value.load(std::memory_order_relaxed);
+        return free_slots(head, m_capacity) == m_capacity;
+    }
+
+    size_t capacity() const { return m_capacity; }
+};
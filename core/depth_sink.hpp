@@ -0,0 +1,42 @@
+#pragma once
+
+#include <type_traits>
+#include <vector>
+
+#include "order_book_types.hpp"
+#include "spsc_ring.hpp"
+
+// DepthSink interface, owned by the OrderBook
+//   void on_level(const LevelDelta&)   a level changed, at most once per level per event
+
+// no market data, the book skips level tracking entirely
+struct NullDepthSink {
+    void on_level(const LevelDelta&) {}
+};
+
+template <class Depth>
+inline constexpr bool publishes_depth = !std::is_same_v<Depth, NullDepthSink>;
+
+// collects every delta, the caller drains or clears deltas
+struct VectorDepthSink {
+    std::vector<LevelDelta> deltas;
+
+    void on_level(const LevelDelta& d) { deltas.push_back(d); }
+};
+
+// publishes each delta into a ring for a publisher thread, spins while the ring is full
+template <class Ring = SpscRing<LevelDelta>>
+class RingDepthSink {
+    Ring* m_ring;
+
+    public:
+
+    explicit RingDepthSink(Ring& ring): m_ring(&ring) {}
+
+    void on_level(const LevelDelta& d) {
+        LevelDelta* slot;
+        while (!(slot = m_ring->claim())) {}
+        new (slot) LevelDelta(d);
+        m_ring->publish();
+    }
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "file_io.hpp"
+#include "order_book_types.hpp"
+#include "spsc_ring.hpp"
+
+// on disk layout of one event, fixed size and independent of the in memory Event
+struct JournalRecord {
+    uint64_t seq;
+    uint64_t order_id;
+    uint64_t timestamp_in;
+    uint64_t expire_time;
+    uint32_t price;
+    int32_t quantity;
+    uint8_t type;
+    uint8_t side;
+    uint8_t tif;
+    uint8_t pad;
+    uint32_t instrument;
+    uint32_t owner;
+    uint32_t reserved;
+};
+static_assert(sizeof(JournalRecord) == 56);
+
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+static_assert(sizeof(JournalHeader) == 16);
+
+inline constexpr char journal_magic[8] = {'D', 'C', 'K', 'J', 'R', 'N', 'L', '\0'};
+inline constexpr uint32_t journal_version = 3;
+
+inline JournalRecord to_record(const Event& e) {
+    JournalRecord r {};
+    r.seq = e.seq;
+    r.order_id = e.order_id;
+    r.timestamp_in = e.timestamp_in;
+    r.expire_time = e.expire_time;
+    r.price = e.price;
+    r.quantity = e.quantity;
+    r.type = static_cast<uint8_t>(e.type);
+    r.side = static_cast<uint8_t>(e.side);
+    r.tif = static_cast<uint8_t>(e.tif);
+    r.instrument = e.instrument;
+    r.owner = e.owner;
+    return r;
+}
+
+inline Event to_event(const JournalRecord& r) {
+    Event e {};
+    e.seq = r.seq;
+    e.type = static_cast<Type>(r.type);
+    e.order_id = r.order_id;
+    e.side = static_cast<Side>(r.side);
+    e.price = r.price;
+    e.quantity = r.quantity;
+    e.timestamp_in = r.timestamp_in;
+    e.expire_time = r.expire_time;
+    e.tif = static_cast<TimeInForce>(r.tif);
+    e.instrument = r.instrument;
+    e.owner = r.owner;
+    return e;
+}
+
+// append only journal, the matching thread copies records into a ring and a writer thread
+// drains it in large contiguous write() calls, so the matcher only waits if the disk falls
+// a whole ring behind
+class EventJournal {
+    SpscRing<JournalRecord> m_ring;
+    int m_fd;
+    std::atomic<bool> m_stop {false};
+    std::atomic<bool> m_failed {false};
+    std::atomic<uint64_t> m_written {0};
+    std::thread m_writer;
+
+    void drain() {
+        constexpr size_t batch_size = 4096;
+        while (true) {
+            std::span<JournalRecord> batch = m_ring.peek_n(batch_size);
+            if (batch.empty()) {
+                if (m_stop.load(std::memory_order_acquire) && m_ring.empty()) return;
+                std::this_thread::yield();
+                continue;
+            }
+            // after a failure records are still drained so the matcher never blocks, but not counted
+            if (!m_failed.load(std::memory_order_relaxed)) {
+                if (write_all(m_fd, batch.data(), batch.size_bytes())) m_written.fetch_add(batch.size(), std::memory_order_relaxed);
+                else m_failed.store(true, std::memory_order_relaxed);
+            }
+            m_ring.release(batch.size());
+        }
+    }
+
+    public:
+
+    // truncates path, ring_capacity must be a power of two
+    explicit EventJournal(const std::string& path, size_t ring_capacity = 1 << 16):
+    m_ring(ring_capacity),
+    m_fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644))
+    {
+        if (m_fd < 0) throw std::runtime_error("EventJournal: cannot open " + path);
+        JournalHeader header {};
+        std::memcpy(header.magic, journal_magic, sizeof(header.magic));
+        header.version = journal_version;
+        header.record_size = sizeof(JournalRecord);
+        if (!write_all(m_fd, &header, sizeof(header))) {
+            ::close(m_fd);
+            throw std::runtime_error("EventJournal: cannot write header to " + path);
+        }
+        m_writer = std::thread([this] { drain(); });
+    }
+
+    EventJournal(const EventJournal&) = delete;
+    EventJournal& operator=(const EventJournal&) = delete;
+
+    // flushes everything appended so far
+    ~EventJournal() {
+        m_stop.store(true, std::memory_order_release);
+        m_writer.join();
+        ::close(m_fd);
+    }
+
+    // single appending thread
+    void append(const Event& e) {
+        JournalRecord* slot;
+        while (!(slot = m_ring.claim())) {}
+        *slot = to_record(e);
+        m_ring.publish();
+    }
+
+    void append(std::span<const Event> events) {
+        for (const Event& e : events) append(e);
+    }
+
+    // records that reached the file
+    uint64_t written() const { return m_written.load(std::memory_order_relaxed); }
+    bool failed() const { return m_failed.load(std::memory_order_relaxed); }
+};
+
+// read only memory map of a journal file
+class JournalReader {
+    MappedFile m_file;
+    std::span<const JournalRecord> m_records;
+
+    public:
+
+    explicit JournalReader(const std::string& path):
+    m_file(path, sizeof(JournalHeader), "JournalReader", MADV_SEQUENTIAL)
+    {
+        const auto* header = reinterpret_cast<const JournalHeader*>(m_file.data());
+        if (std::memcmp(header->magic, journal_magic, sizeof(journal_magic)) != 0
+            || header->version != journal_version || header->record_size != sizeof(JournalRecord)) {
+            throw std::runtime_error("JournalReader: not a journal or wrong version " + path);
+        }
+        // a torn last record from a crash is ignored
+        size_t n = (m_file.size() - sizeof(JournalHeader)) / sizeof(JournalRecord);
+        m_records = {reinterpret_cast<const JournalRecord*>(m_file.data() + sizeof(JournalHeader)), n};
+    }
+
+    std::span<const JournalRecord> records() const { return m_records; }
+};
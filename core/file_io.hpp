@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// write the whole buffer, a signal interrupting write() is retried, any other error is final
+inline bool write_all(int fd, const void* data, size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while (len) {
+        ssize_t n = ::write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// read only, prefaulted memory map of a whole file, shared by the journal and snapshot readers
+// errors throw runtime_error prefixed with who
+class MappedFile {
+    int m_fd {-1};
+    void* m_map {nullptr};
+    size_t m_len {0};
+
+    public:
+
+    // throws if the file is shorter than min_size, advice is passed to madvise
+    MappedFile(const std::string& path, size_t min_size, const std::string& who, int advice = MADV_NORMAL) {
+        m_fd = ::open(path.c_str(), O_RDONLY);
+        if (m_fd < 0) throw std::runtime_error(who + ": cannot open " + path);
+        struct stat st;
+        if (::fstat(m_fd, &st) != 0 || static_cast<size_t>(st.st_size) < min_size) {
+            ::close(m_fd);
+            throw std::runtime_error(who + ": truncated " + path);
+        }
+        m_len = static_cast<size_t>(st.st_size);
+        m_map = ::mmap(nullptr, m_len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, m_fd, 0);
+        if (m_map == MAP_FAILED) {
+            ::close(m_fd);
+            throw std::runtime_error(who + ": cannot map " + path);
+        }
+        if (advice != MADV_NORMAL) ::madvise(m_map, m_len, advice);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        ::munmap(m_map, m_len);
+        ::close(m_fd);
+    }
+
+    const char* data() const { return static_cast<const char*>(m_map); }
+    size_t size() const { return m_len; }
+};
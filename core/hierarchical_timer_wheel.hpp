@@ -1,46 +1,200 @@
+#pragma once
+
 #include <vector>
 #include <cstdint>
-#include <deque>
+#include <bit>
+#include <stdexcept>
 
+// timer slot, prev/next link it into its bucket, a free slot reuses next as the free list link
 struct TWNode {
-    uint64_t timestamp;
+    uint64_t expiry_tick;
     uint64_t label;
-    uint8_t active;
-    uint32_t next_node_in_bucket;
+    uint32_t prev;
+    uint32_t next;
+    uint32_t bucket;
+    uint32_t generation;
 };
 
+// generation guards against cancelling a slot that has since been recycled
 struct TWHandle {
-    uint32_t idx;
+    uint32_t idx {UINT32_MAX};
+    uint32_t generation {0};
+
+    bool valid() const { return idx != UINT32_MAX; }
 };
 
+// 4 tier hashed timer wheel, tier t buckets are wheel_size^t ticks wide
+// add/cancel are O(1), advance cascades a higher tier bucket down whenever the ticks below it wrap
+// nodes are preallocated, running past capacity grows the slab
 class TimerWheel {
-    std::deque<TWNode> nodes;
-    std::vector<std::vector<std::vector<TWHandle>>> tiers;
-    int m_resolution, m_wheelsize;
+    static constexpr uint32_t null_idx = UINT32_MAX;
+    static constexpr int n_tiers = 4;
+
+    std::vector<TWNode> m_nodes;
+    std::vector<uint32_t> m_buckets; // n_tiers * wheel_size list heads
+    std::vector<uint32_t> m_tails;
+    uint32_t m_free {null_idx};
+    uint64_t m_resolution;
+    uint32_t m_wheelsize, m_bits, m_mask;
+    uint64_t m_now_tick {0};
+    size_t m_count[n_tiers] {};
 
     public:
 
-    TimerWheel (int resolution, int wheel_size): m_resolution(resolution), m_wheelsize(wheel_size) {
-        tiers.reserve(4);
-        for (int i = 0; i < 4; i++) tiers[i].reserve(wheel_size);
+    // resolution: time units per tick, wheel_size: buckets per tier (power of two), start: current time
+    TimerWheel (uint64_t resolution, uint32_t wheel_size, size_t capacity = 1024, uint64_t start = 0):
+    m_buckets(n_tiers * wheel_size, null_idx),
+    m_tails(n_tiers * wheel_size, null_idx),
+    m_resolution(resolution),
+    m_wheelsize(wheel_size),
+    m_bits(std::countr_zero(wheel_size)),
+    m_mask(wheel_size - 1)
+    {
+        if (resolution == 0 || wheel_size < 2 || !std::has_single_bit(wheel_size) || m_bits * n_tiers > 48) {
+            throw std::invalid_argument("TimerWheel: bad resolution or wheel size");
+        }
+        m_now_tick = start / resolution;
+        m_nodes.resize(capacity);
+        for (size_t i = capacity; i-- > 0;) release_node(static_cast<uint32_t>(i));
     }
 
+    // fires on the first advance() whose time reaches timestamp rounded up to a whole tick,
+    // so up to one tick late
     TWHandle add (uint64_t timestamp, uint64_t label) {
-        uint32_t idx = (uint32_t) nodes.size();
-        nodes.push_back({timestamp, label, 1, UINT32_MAX});
-        // push to bucket
-        return {idx};
+        if (m_free == null_idx) {
+            m_nodes.push_back({});
+            release_node(static_cast<uint32_t>(m_nodes.size() - 1));
+        }
+        uint32_t idx = m_free;
+        TWNode& n = m_nodes[idx];
+        m_free = n.next;
+        // the current tick has already been processed, past due timers fire on the next one
+        uint64_t tick = (timestamp + m_resolution - 1) / m_resolution;
+        n.expiry_tick = tick > m_now_tick ? tick : m_now_tick + 1;
+        n.label = label;
+        insert(idx);
+        return {idx, n.generation};
     }
 
     bool cancel (TWHandle handle) {
-        if (handle.idx > nodes.size()) return false;
-        auto &n = nodes[handle.idx];
-        if (!n.active)
-        n.active = 0;
+        if (!handle.valid() || handle.idx >= m_nodes.size()) return false;
+        TWNode& n = m_nodes[handle.idx];
+        if (n.generation != handle.generation || n.bucket == null_idx) return false;
+        unlink(handle.idx);
+        release_node(handle.idx);
         return true;
     }
 
+    // time the timer is due, rounded up to its tick, 0 if it has fired or been cancelled
+    uint64_t expiry (TWHandle handle) const {
+        if (!handle.valid() || handle.idx >= m_nodes.size()) return 0;
+        const TWNode& n = m_nodes[handle.idx];
+        if (n.generation != handle.generation || n.bucket == null_idx) return 0;
+        return n.expiry_tick * m_resolution;
+    }
+
+    // expire every timer whose tick is at or before now's, a timer due inside now's tick waits
+    // for the next one, callback(label) runs after the slot is recycled so it may add or cancel
+    // timers, returns number fired
+    template <class F>
+    size_t advance (uint64_t now, F&& callback) {
+        const uint64_t target = now / m_resolution;
+        size_t fired {0};
+
+        while (m_now_tick < target) {
+            // skip straight to the next bucket boundary of the lowest non-empty tier
+            int tier = 0;
+            while (tier < n_tiers && m_count[tier] == 0) tier++;
+            if (tier == n_tiers) {
+                m_now_tick = target;
+                break;
+            }
+            if (tier > 0) {
+                uint64_t span = uint64_t{1} << (m_bits * tier);
+                uint64_t next = (m_now_tick / span + 1) * span;
+                if (next > target) {
+                    m_now_tick = target;
+                    break;
+                }
+                m_now_tick = next - 1;
+            }
 
+            m_now_tick++;
+
+            // cascade from the highest tier whose lower ticks just wrapped
+            int top = 0;
+            while (top + 1 < n_tiers && (m_now_tick & ((uint64_t{1} << (m_bits * (top + 1))) - 1)) == 0) top++;
+            for (int t = top; t > 0; t--) cascade(t);
+
+            uint32_t& head = m_buckets[m_now_tick & m_mask];
+            while (head != null_idx) {
+                uint32_t idx = head;
+                uint64_t label = m_nodes[idx].label;
+                unlink(idx);
+                release_node(idx);
+                fired++;
+                callback(label);
+            }
+        }
+        return fired;
+    }
+
+    size_t size() const { return m_count[0] + m_count[1] + m_count[2] + m_count[3]; }
+    size_t capacity() const { return m_nodes.size(); }
+    size_t bytes() const {
+        return m_nodes.capacity() * sizeof(TWNode) + (m_buckets.capacity() + m_tails.capacity()) * sizeof(uint32_t);
+    }
 
+    private:
 
-}
\ No newline at end of file
+    void release_node(uint32_t idx) {
+        TWNode& n = m_nodes[idx];
+        n.generation++;
+        n.bucket = null_idx;
+        n.next = m_free;
+        m_free = idx;
+    }
+
+    // append to the bucket for the node's tick relative to the current one, expiry_tick >= m_now_tick
+    void insert(uint32_t idx) {
+        TWNode& n = m_nodes[idx];
+        uint64_t tick = n.expiry_tick;
+        uint64_t delta = tick - m_now_tick;
+
+        int tier = 0;
+        while (tier + 1 < n_tiers && delta >= (uint64_t{1} << (m_bits * (tier + 1)))) tier++;
+        // beyond the top tier: park in its furthest bucket, cascading re-files it later
+        uint64_t horizon = uint64_t{1} << (m_bits * n_tiers);
+        if (delta >= horizon) tick = m_now_tick + horizon - 1;
+
+        uint32_t bucket = tier * m_wheelsize + ((tick >> (m_bits * tier)) & m_mask);
+        uint32_t& tail = m_tails[bucket];
+        n.bucket = bucket;
+        n.prev = tail;
+        n.next = null_idx;
+        if (tail == null_idx) m_buckets[bucket] = idx;
+        else m_nodes[tail].next = idx;
+        tail = idx;
+        m_count[tier]++;
+    }
+
+    void unlink(uint32_t idx) {
+        TWNode& n = m_nodes[idx];
+        if (n.prev == null_idx) m_buckets[n.bucket] = n.next;
+        else m_nodes[n.prev].next = n.next;
+        if (n.next == null_idx) m_tails[n.bucket] = n.prev;
+        else m_nodes[n.next].prev = n.prev;
+        m_count[n.bucket / m_wheelsize]--;
+        n.bucket = null_idx;
+    }
+
+    // re-file every node in the current bucket of tier t, they all land in lower tiers
+    void cascade(int tier) {
+        uint32_t& head = m_buckets[tier * m_wheelsize + ((m_now_tick >> (m_bits * tier)) & m_mask)];
+        while (head != null_idx) {
+            uint32_t idx = head;
+            unlink(idx);
+            insert(idx);
+        }
+    }
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+// HDR style log-linear histogram: values below 2^sub_bucket_bits are exact, above that
+// each power of two is split into 2^sub_bucket_bits linear buckets (~3% relative error)
+// fixed size, record is O(1) with no allocation
+// one thread records, any thread may read or merge, counters are relaxed atomics
+class LatencyHistogram {
+    static constexpr int sub_bucket_bits = 5;
+    static constexpr uint64_t sub_buckets = uint64_t{1} << sub_bucket_bits;
+    static constexpr size_t n_buckets = (65 - sub_bucket_bits) << sub_bucket_bits;
+
+    std::array<std::atomic<uint64_t>, n_buckets> m_counts {};
+    std::atomic<uint64_t> m_total {0};
+    std::atomic<uint64_t> m_min {UINT64_MAX};
+    std::atomic<uint64_t> m_max {0};
+
+    static size_t index(uint64_t v) {
+        if (v < sub_buckets) return v;
+        int msb = 63 - std::countl_zero(v);
+        uint64_t exponent = msb - sub_bucket_bits + 1;
+        uint64_t sub = (v >> (msb - sub_bucket_bits)) - sub_buckets;
+        return (exponent << sub_bucket_bits) + sub;
+    }
+
+    // largest value that maps to bucket i
+    static uint64_t highest(size_t i) {
+        uint64_t exponent = i >> sub_bucket_bits;
+        if (exponent == 0) return i;
+        uint64_t sub = i & (sub_buckets - 1);
+        uint64_t width = uint64_t{1} << (exponent - 1);
+        return ((sub_buckets + sub) << (exponent - 1)) + width - 1;
+    }
+
+    // single writer increment, no locked instruction
+    static void bump(std::atomic<uint64_t>& c, uint64_t n) {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    public:
+
+    void record(uint64_t v, uint64_t n = 1) {
+        bump(m_counts[index(v)], n);
+        bump(m_total, n);
+        if (v < m_min.load(std::memory_order_relaxed)) m_min.store(v, std::memory_order_relaxed);
+        if (v > m_max.load(std::memory_order_relaxed)) m_max.store(v, std::memory_order_relaxed);
+    }
+
+    // add other's counts into this one, run on this histogram's writer thread
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < n_buckets; i++) {
+            uint64_t n = other.m_counts[i].load(std::memory_order_relaxed);
+            if (n) bump(m_counts[i], n);
+        }
+        bump(m_total, other.m_total.load(std::memory_order_relaxed));
+        uint64_t lo = other.m_min.load(std::memory_order_relaxed), hi = other.m_max.load(std::memory_order_relaxed);
+        if (lo < m_min.load(std::memory_order_relaxed)) m_min.store(lo, std::memory_order_relaxed);
+        if (hi > m_max.load(std::memory_order_relaxed)) m_max.store(hi, std::memory_order_relaxed);
+    }
+
+    // value at percentile p (0-100), reported as the top of its bucket and clamped to max
+    uint64_t percentile(double p) const {
+        uint64_t total = m_total.load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>((p / 100.0) * (total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < n_buckets; i++) {
+            seen += m_counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                uint64_t v = highest(i), hi = max();
+                return v < hi ? v : hi;
+            }
+        }
+        return max();
+    }
+
+    uint64_t count() const { return m_total.load(std::memory_order_relaxed); }
+    uint64_t min() const { return count() ? m_min.load(std::memory_order_relaxed) : 0; }
+    uint64_t max() const { return m_max.load(std::memory_order_relaxed); }
+
+    void reset() {
+        for (auto& c : m_counts) c.store(0, std::memory_order_relaxed);
+        m_total.store(0, std::memory_order_relaxed);
+        m_min.store(UINT64_MAX, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+// bounded lock free ring for many producers and one consumer
+// every slot carries a sequence number: slot i is free for the producer at position p when
+// seq == p, and full for the consumer at p when seq == p + 1, so producers only contend on
+// the one CAS that claims a position and never wait on each other to publish
+template <class T>
+class MpscRing {
+    static constexpr size_t cacheLineSize = 64;
+
+    struct Slot {
+        std::atomic<size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* get() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    const size_t m_capacity, m_mask;
+    Slot* m_slots;
+
+    alignas(cacheLineSize) std::atomic<size_t> m_head {0}; // next position to claim, producers
+    alignas(cacheLineSize) std::atomic<size_t> m_tail {0}; // next position to read, consumer only
+
+    // claim the next free position, nullptr if the ring is full
+    Slot* claim_slot() {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = m_slots[pos & m_mask];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return &slot;
+            }
+            else if (diff < 0) {
+                return nullptr;
+            }
+            else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // oldest published slot, nullptr if the next one has not been published yet
+    Slot* ready_slot(size_t pos) {
+        Slot& slot = m_slots[pos & m_mask];
+        return slot.seq.load(std::memory_order_acquire) == pos + 1 ? &slot : nullptr;
+    }
+
+    void free_slot(Slot& slot, size_t pos) {
+        slot.get()->~T();
+        slot.seq.store(pos + m_capacity, std::memory_order_release);
+    }
+
+    public:
+
+    // capacity must be a power of two
+    explicit MpscRing(size_t capacity):
+    m_capacity(capacity),
+    m_mask(capacity - 1),
+    m_slots(static_cast<Slot*>(::operator new[](capacity * sizeof(Slot))))
+    {
+        for (size_t i = 0; i < capacity; i++) new (&m_slots[i].seq) std::atomic<size_t>(i);
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    ~MpscRing() {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        for (Slot* slot; (slot = ready_slot(pos)); pos++) slot->get()->~T();
+        ::operator delete[](m_slots);
+    }
+
+    // any thread
+    bool try_push(const T& x) {
+        Slot* slot = claim_slot();
+        if (!slot) return false;
+        size_t pos = slot->seq.load(std::memory_order_relaxed);
+        new (slot->storage) T(x);
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only, also false while the oldest claimed slot is still being written
+    bool try_pop(T& out) {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Slot* slot = ready_slot(pos);
+        if (!slot) return false;
+        out = std::move(*slot->get());
+        free_slot(*slot, pos);
+        m_tail.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // pop up to n items, stops at the first slot not yet published, returns number popped
+    size_t try_pop_n(T* out, size_t n) {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        size_t i = 0;
+        for (; i < n; i++) {
+            Slot* slot = ready_slot(pos + i);
+            if (!slot) break;
+            out[i] = std::move(*slot->get());
+            free_slot(*slot, pos + i);
+        }
+        m_tail.store(pos + i, std::memory_order_relaxed);
+        return i;
+    }
+
+    // zero copy consumer side: read the oldest slot in place, then release it
+    T* peek() {
+        Slot* slot = ready_slot(m_tail.load(std::memory_order_relaxed));
+        return slot ? slot->get() : nullptr;
+    }
+
+    void release() {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        free_slot(m_slots[pos & m_mask], pos);
+        m_tail.store(pos + 1, std::memory_order_relaxed);
+    }
+
+    // consumer side, true if nothing is published or being written
+    bool empty() {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_relaxed);
+    }
+};
@@ -1,307 +1,536 @@
-#include <map>
-#include <unordered_map>
-#include <deque>
+#pragma once
+
 #include <cstdint>
 #include <vector>
-#include <chrono>
 #include <iostream>
-#include <iterator>
+#include <span>
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
 
 #include "order_book_types.hpp"
+#include "book_snapshot.hpp"
+#include "depth_sink.hpp"
+#include "hierarchical_timer_wheel.hpp"
+#include "order_index.hpp"
+#include "order_pool.hpp"
+#include "owner_orders.hpp"
+#include "sweep_pool.hpp"
+#include "price_ladder.hpp"
+#include "trade_sink.hpp"
 
-using BookMap = std::map<Price, std::deque<OrderId>>;
-using SellIt = BookMap::iterator;
-using BuyRIt = BookMap::reverse_iterator;
+struct BookConfig {
+    LadderConfig ladder {};
+    // resting orders preallocated in the pool and the index
+    size_t order_capacity {1 << 16};
+    // good till time expiry, ticks of timer_resolution ns, an order expires once time reaches
+    // its expire_time rounded up to a tick
+    uint64_t timer_resolution {1'000'000};
+    uint32_t timer_wheel_size {256};
+    // placement of the order pool, the flat ladder levels take ladder.memory
+    MemoryPolicy memory {};
+};
 
-class OrderBook {
-    public:
+// what a book holds, live and dead counts plus bytes per structure (capacity, not size)
+// queue_bytes covers non-empty levels, an emptied flat ladder level keeps at most
+// SweepQueue::kept_slots slots of buffer
+struct BookMemoryStats {
+    size_t live_orders {0};
+    size_t dead_slots {0}; // cancelled or filled slots still held by level FIFOs
+    size_t free_slots {0}; // pool slots ready for reuse
+    size_t levels {0};
 
-    explicit OrderBook() {
-        if (!m_sell_book.empty()) { 
-            m_best_sell_it = m_sell_book.begin();
-            m_has_best_sell = true;
-        }
-        if (!m_buy_book.empty())  {
-            m_best_buy_it = m_buy_book.rbegin();
-            m_has_best_buy = true;
-        }
+    size_t pool_bytes {0};
+    size_t index_bytes {0};
+    size_t ladder_bytes {0};
+    size_t queue_bytes {0};
+    size_t timer_bytes {0};
+    size_t owner_bytes {0};
+
+    size_t total_bytes() const { return pool_bytes + index_bytes + ladder_bytes + queue_bytes + timer_bytes + owner_bytes; }
+};
+
+// which of an owner's orders a mass cancel pulls, by default all of them
+struct MassCancelFilter {
+    std::optional<Side> side {};
+    Price min_price {0};
+    Price max_price {UINT32_MAX};
+};
+
+// what differs between an incoming buy and an incoming sell, see OrderBook::match
+template <Side S>
+struct SideTraits {
+    static constexpr Side opposite = S == Side::Buy ? Side::Sell : Side::Buy;
+
+    // fills are always reported seller first
+    static Trade trade(OrderId taker, OrderId maker, Price price, int32_t quantity, Timestamp now) {
+        if constexpr (S == Side::Buy) return Trade{maker, taker, price, quantity, now};
+        else return Trade{taker, maker, price, quantity, now};
     }
+};
 
-    bool on_new(const Event& event, std::vector<Trade>& trades_out) {
+// Ladder picks the price level backend, MapLadder or FlatLadder (see price_ladder.hpp)
+// Index maps OrderId to pool handle, StdOrderIndex, LinearProbeIndex or WindowIndex (see order_index.hpp)
+// Sink receives the fills (see trade_sink.hpp)
+// Depth receives coalesced price level deltas (see depth_sink.hpp)
+// Pool holds the resting orders and lays out the level FIFOs, OrderPool (one node per order),
+// SoaOrderPool (one array per field) or SweepOrderPool (contiguous quantities per level, see sweep_pool.hpp)
+template <template <class, Side> class Ladder = MapLadder, class Index = StdOrderIndex, class Sink = VectorTradeSink, class Depth = NullDepthSink, class Pool = OrderPool>
+class OrderBook {
+    public:
 
-        if (!(event.price > 0 && event.quantity > 0)) return false;
+    using Level = BasicPriceLevel<typename Pool::Queue>;
+    using SellBook = Ladder<Level, Side::Sell>;
+    using BuyBook = Ladder<Level, Side::Buy>;
 
-        if (event.side == Side::Buy) {
-            // look for best sell price (lowest sell)
-            Price best_sell_price;
-            
-            int32_t quantity_remaining {event.quantity};
-            while (fix_best_sell(best_sell_price) && quantity_remaining > 0) {
-                // check order sells <= buying price
-                if (best_sell_price > event.price) break;
-                
-                auto& price_queue = m_sell_book.at(best_sell_price);
-                
-                // continue buying from this order
-                OrderId oid {price_queue.front()};
-                Order& maker = m_order_index.at(oid);
-                
-                int32_t qty_bought {std::min(quantity_remaining, maker.quantity_remaining)};
-                maker.quantity_remaining -= qty_bought;
-                quantity_remaining -= qty_bought;
-
-                // add trade to output
-                trades_out.emplace_back(
-                    maker.order_id, event.order_id, best_sell_price, qty_bought, std::chrono::steady_clock::now()
-                );
-
-                // if order is now empty then delete it
-                if (maker.quantity_remaining == 0) {
-                    price_queue.pop_front();
-                    m_order_index.erase(oid);
-                }
-                // // if price is now empty then delete it
-                // if (price_queue.empty()) m_sell_book.erase(best_sell_price);
-            }
+    explicit OrderBook(const BookConfig& config = {}, Sink sink = {}, Depth depth = {}):
+    m_sink(std::move(sink)),
+    m_sell_book(config.ladder),
+    m_buy_book(config.ladder),
+    m_pool(config.order_capacity, config.memory),
+    m_order_index(config.order_capacity),
+    m_timers(config.timer_resolution, config.timer_wheel_size, config.order_capacity),
+    m_owners(config.order_capacity),
+    m_depth(std::move(depth))
+    {}
 
-            // if still leftover to buy then add to buy book
-            if (quantity_remaining > 0) {
-                m_order_index.try_emplace(
-                    event.order_id,
-                    Order{event.order_id, event.side, event.price, quantity_remaining, event.seq, true}
-                );
-                m_buy_book[event.price].push_back(event.order_id);
-                
-                // update cache
-                if (!m_has_best_buy || event.price > m_best_buy_it->first) {
-                    auto it = m_buy_book.find(event.price);
-                    m_best_buy_it = make_reverse_iterator(std::next(it));
-                    m_has_best_buy = true;
-                }
-            }
+    // each per-event entry point first cancels orders due by the event's timestamp_in (expiry
+    // runs on event time) and records its seq for next_seq(), so applying events one at a time
+    // or through on_batch leaves the same book, however a journal is batched on replay
 
+    // fills are stamped with now, read once by the caller per event (or batch)
+    bool on_new(const Event& event, Timestamp now) {
+        begin_event(event);
+        bool accepted = add(event, now);
+        publish_depth();
+        return accepted;
+    }
 
-            return true;
-        }
-        else if (event.side == Side::Sell) {
-            // look for best sell price (lowest sell)
-            Price best_buy_price;
-            
-            int32_t quantity_remaining {event.quantity};
-            while (fix_best_buy(best_buy_price) && quantity_remaining > 0) {
-                // check order buys >= selling price
-                if (best_buy_price < event.price) break;
-                
-                // continue buying
-                auto& price_queue = m_buy_book.at(best_buy_price);
-                OrderId oid {price_queue.front()};
-                Order& maker = m_order_index.at(oid);
-
-                int32_t qty_bought {std::min(quantity_remaining, maker.quantity_remaining)};
-                maker.quantity_remaining -= qty_bought;
-                quantity_remaining -= qty_bought;
-
-                // add trade to output
-                trades_out.emplace_back(
-                    event.order_id, maker.order_id, best_buy_price, qty_bought, std::chrono::steady_clock::now()
-                );
-
-                // if order is now empty then delete it
-                if (maker.quantity_remaining == 0) {
-                    price_queue.pop_front();
-                    m_order_index.erase(oid);
-                }
-                // // if price is now empty then delete it
-                // if (price_queue.empty()) m_buy_book.erase(best_buy_price);
-            }
+    // unlinks the order from its level and returns the slot, O(1) apart from the index lookup
+    bool on_cancel(const Event& event) {
+        begin_event(event);
+        bool accepted = cancel(event.order_id);
+        publish_depth();
+        return accepted;
+    }
+    
+    // same side, same price, quantity not increased: amend in place and keep queue priority
+    // anything else loses priority, it is cancelled and re-entered (and may match)
+    // either way the order keeps its owner
+    bool on_replace(const Event& event, Timestamp now) { 
+        begin_event(event);
+        bool accepted = replace(event, now);
+        publish_depth();
+        return accepted;
+    }
 
-            // if still leftover to buy then add to buy book
-            if (quantity_remaining > 0) {
-                m_order_index.try_emplace(
-                    event.order_id,
-                    Order{event.order_id, event.side, event.price, quantity_remaining, event.seq, true}
-                );
-                m_sell_book[event.price].push_back(event.order_id);
-                
-                // update cache
-                if (!m_has_best_sell || event.price < m_best_sell_it->first) {
-                    m_best_sell_it = m_sell_book.find(event.price);
-                    m_has_best_sell = true;
-                }
+    // cancel every resting order of event.owner that passes filter in one walk of the owner's
+    // list, oldest first, returns number cancelled
+    size_t on_mass_cancel(const Event& event, const MassCancelFilter& filter = {}) {
+        begin_event(event);
+        size_t cancelled {0};
+        m_owners.for_each(event.owner, [&](OrderHandle h) {
+            Price price = m_pool.price(h);
+            if (filter.side && *filter.side != m_pool.side(h)) return;
+            if (price < filter.min_price || price > filter.max_price) return;
+            m_order_index.erase(m_pool.order_id(h));
+            if (m_pool.side(h) == Side::Buy) remove_order(m_buy_book, h);
+            else remove_order(m_sell_book, h);
+            cancelled++;
+        });
+        publish_depth();
+        return cancelled;
+    }
+
+    // apply a run of events in order, returns how many were accepted
+    size_t on_batch(std::span<const Event> events, Timestamp now) {
+        size_t accepted {0};
+        for (const Event& event : events) {
+            switch (event.type) {
+            case Type::New:
+                accepted += on_new(event, now);
+                break;
+            case Type::Cancel:
+                accepted += on_cancel(event);
+                break;
+            case Type::Replace:
+                accepted += on_replace(event, now);
+                break;
+            case Type::MassCancel:
+                accepted += on_mass_cancel(event) > 0;
+                break;
             }
+        }
+        return accepted;
+    }
 
+    // aggregate at one price, zero quantity and orders if the level does not exist
+    LevelDepth depth_at(Side side, Price price) const {
+        const Level* level = (side == Side::Buy) ? m_buy_book.find(price) : m_sell_book.find(price);
+        if (!level) return {price, 0, 0};
+        return {price, level->quantity, level->orders};
+    }
 
-            return true;
-        }
-        return false;
+    // best out.size() levels of one side, best first, returns number written
+    size_t top_n(Side side, std::span<LevelDepth> out) const {
+        return (side == Side::Buy) ? top_levels(m_buy_book, out) : top_levels(m_sell_book, out);
     }
 
-    OrderBook& operator -= (const OrderId id) {
-        if (!on_cancel(id)) {};
-        return *this;
+    // seq of the last event applied + 1, journal replay resumes here
+    uint64_t next_seq() const { return m_next_seq; }
+
+    // copy the resting book into out, levels best to worst with their orders in FIFO order
+    // cost is linear in resting orders with no allocation once out has grown, the file is
+    // written elsewhere (see SnapshotWriter)
+    void snapshot(BookSnapshot& out) const {
+        out.clear();
+        out.next_seq = m_next_seq;
+        out.orders.reserve(m_pool.live());
+        capture_levels(m_sell_book, out);
+        out.sell_levels = static_cast<uint32_t>(out.levels.size());
+        capture_levels(m_buy_book, out);
     }
-    
-    bool on_cancel(const OrderId id) { 
-        auto it = m_order_index.find(id);
-        if (it == m_order_index.end()) return false;
-        it->second.active = false;
-        return true;
+
+    // bulk rebuild from a snapshot into an empty book, throws if the book is not empty
+    // or the snapshot is inconsistent, a failed restore leaves the book empty
+    void restore(const SnapshotView& snap) {
+        if (m_pool.live()) throw std::logic_error("OrderBook::restore: book is not empty");
+        check_snapshot(snap);
+        try {
+            size_t n = restore_levels(m_sell_book, snap.sell_levels, snap.orders, 0);
+            restore_levels(m_buy_book, snap.buy_levels, snap.orders, n);
+        }
+        catch (...) {
+            // the book started empty, so every indexed order came from this snapshot
+            for (const SnapshotOrder& o : snap.orders) cancel(o.order_id);
+            m_dirty.clear();
+            throw;
+        }
+        m_next_seq = snap.next_seq;
     }
-    
-    bool on_replace(const Event& event, std::vector<Trade>& trades_out) { 
-        if (!on_cancel(event.order_id)) return false;
-        return on_new(event, trades_out);
+
+    // walks every level, cheap enough to poll between batches but not per event
+    BookMemoryStats memory_stats() const {
+        BookMemoryStats stats;
+        stats.live_orders = m_pool.live();
+        stats.free_slots = m_pool.capacity() - m_pool.live();
+        auto visit = [&](Price, const Level& level) {
+            stats.levels++;
+            stats.dead_slots += m_pool.dead(level.queue);
+            stats.queue_bytes += m_pool.bytes(level.queue);
+        };
+        m_sell_book.for_each(visit);
+        m_buy_book.for_each(visit);
+
+        stats.pool_bytes = m_pool.bytes();
+        stats.index_bytes = m_order_index.bytes();
+        stats.ladder_bytes = m_sell_book.bytes() + m_buy_book.bytes();
+        stats.timer_bytes = m_timers.bytes();
+        stats.owner_bytes = m_owners.bytes();
+        return stats;
     }
 
-    
-    // bool find_best_price(Price& return_price, std::iterator)
     void log_books() const{
-        std::cout << "\nBooks\n----\nSell\nPrice | Quantity(Order Id)\n";
-        for(auto it = m_sell_book.rbegin(); it != m_sell_book.rend(); it++) {
-            std::cout << it->first << " | ";
-            for (OrderId oid : it->second) {
-                std::cout << m_order_index.at(oid).quantity_remaining << "(" << oid << (m_order_index.at(oid).active ? "" : "/cancelled") << "), ";
-            }
+        auto log_level = [&](Price price, const Level& level) {
+            std::cout << price << " | ";
+            m_pool.for_each(level.queue, [](const Order& order) {
+                std::cout << order.quantity_remaining << "(" << order.order_id << "), ";
+            });
             std::cout << "\n";
-        }
+        };
+
+        std::cout << "\nBooks\n----\nSell\nPrice | Quantity(Order Id)\n";
+        // sells are visited best (lowest) first, print highest first
+        std::vector<std::pair<Price, const Level*>> sells;
+        m_sell_book.for_each([&](Price price, const Level& level) { sells.emplace_back(price, &level); });
+        for (auto it = sells.rbegin(); it != sells.rend(); it++) log_level(it->first, *it->second);
         
         std::cout << "Buy\nPrice | Quantity(Order Id)\n";
-        for(auto it = m_buy_book.rbegin(); it != m_buy_book.rend(); it++) {
-            std::cout << it->first << " | ";
-            for (OrderId oid : it->second) {
-                std::cout << m_order_index.at(oid).quantity_remaining << "(" << oid << (m_order_index.at(oid).active ? "" : "/cancelled") << "), ";
-            }
-            std::cout << "\n";
-        }
+        m_buy_book.for_each(log_level);
 
         std::cout << "\n";
     }
     
+    Sink& sink() { return m_sink; }
+    Depth& depth_sink() { return m_depth; }
+
     private:
     
-    BookMap m_sell_book;
-    BookMap m_buy_book;
-    std::unordered_map<OrderId, Order> m_order_index;
-    
-    SellIt m_best_sell_it;
-    BuyRIt m_best_buy_it;
-    bool m_has_best_sell {false};
-    bool m_has_best_buy {false};
+    Sink m_sink;
+    SellBook m_sell_book;
+    BuyBook m_buy_book;
+    Pool m_pool;
+    Index m_order_index;
+    TimerWheel m_timers;
+    OwnerOrders m_owners;
+    uint64_t m_next_seq {0};
+    Depth m_depth;
+    std::vector<LevelDelta> m_dirty; // levels touched by the current event, see touch()
+    std::vector<Trade> m_fills; // trades of the current run of filled makers, see fill_run()
     
-    void clean_book (BookMap& book, const std::vector<Price>& prices_to_delete) {
-        for (Price p : prices_to_delete) book.erase(p);
+    // orders due by the event's time (expire_time rounded up to the timer tick) go first, their
+    // depth deltas go out with the event's own
+    void begin_event(const Event& event) {
+        if (m_timers.size()) m_timers.advance(event.timestamp_in, [&](uint64_t order_id) { cancel(order_id); });
+        m_next_seq = event.seq + 1;
     }
-    
-    // Cache aware best price functions
-    bool fix_best_sell(Price& out) {
-        while (m_has_best_sell) {
-            auto& q = m_best_sell_it->second;
-            
-            while (!q.empty()) {
-                OrderId oid = q.front();
-                auto it = m_order_index.find(oid);
-                if (it == m_order_index.end() || !it->second.active) {
-                    if (it != m_order_index.end()) m_order_index.erase(it);
-                    q.pop_front();
-                }
-                else {
-                    out = m_best_sell_it->first;
-                    return true;
-                }
-            }
-            
-            auto next = std::next(m_best_sell_it);
-            m_sell_book.erase(m_best_sell_it);
-            if (next == m_sell_book.end()) {
-                m_has_best_sell = false;
-                return false;
-            }
-            m_best_sell_it = next;
+
+    bool add(const Event& event, Timestamp now) {
+
+        if (!(event.price > 0 && event.quantity > 0)) return false;
+
+        m_sink.begin();
+
+        // the one runtime side branch per event, the matching below is specialised per side
+        switch (event.side) {
+        case Side::Buy:
+            return match<Side::Buy>(event, now);
+        case Side::Sell:
+            return match<Side::Sell>(event, now);
         }
         return false;
     }
-    
-    bool fix_best_buy(Price& out) {
-        while (m_has_best_buy) {
-            auto& q = m_best_buy_it->second;
-            
-            while (!q.empty()) {
-                OrderId oid = q.front();
-                auto it = m_order_index.find(oid);
-                if (it == m_order_index.end() || !it->second.active) {
-                    if (it != m_order_index.end()) m_order_index.erase(it);
-                    q.pop_front();
-                }
-                else {
-                    out = m_best_buy_it->first;
-                    return true;
-                }
-            }
-            
-            auto it = std::prev(m_best_buy_it.base());
-            it = m_buy_book.erase(it);
-            if (m_buy_book.empty()) {
-                m_has_best_buy = false;
-                return false;
+
+    // cross an incoming order on side S against the opposite side, then rest any remainder
+    template <Side S>
+    bool match(const Event& event, Timestamp now) {
+        using Traits = SideTraits<S>;
+        auto& resting = side_book<Traits::opposite>();
+
+        // fill or kill: leave the book untouched unless the whole quantity crosses
+        if (event.tif == TimeInForce::FOK && !can_fill(resting, event.price, event.quantity)) return true;
+
+        int32_t quantity_remaining {event.quantity};
+        Price best_price;
+        while (quantity_remaining > 0) {
+            Level* best_level = resting.best(best_price);
+            if (!best_level) break;
+            // stop once the best resting price no longer crosses the limit
+            if (better_price<Traits::opposite>(event.price, best_price)) break;
+
+            // fill makers front to back, the pool has already taken filled makers off the FIFO
+            auto& level = *best_level;
+            int32_t qty_filled = m_pool.fill(level.queue, quantity_remaining,
+                [&](std::span<const OrderHandle> handles, std::span<const OrderId> makers, std::span<const int32_t> quantities) {
+                    fill_run<Traits>(level, event.order_id, best_price, handles, makers, quantities, now);
+                },
+                [&](OrderHandle h, int32_t qty) {
+                    m_sink.on_trade(Traits::trade(event.order_id, m_pool.order_id(h), best_price, qty, now));
+                });
+            quantity_remaining -= qty_filled;
+            level.quantity -= qty_filled;
+            touch(Traits::opposite, best_price);
+
+            // if price is now empty then delete it
+            if (level.empty()) resting.erase(best_price);
+        }
+
+        // if still leftover then rest it on our own side, unless immediate or cancel
+        if (quantity_remaining > 0 && event.tif == TimeInForce::GTC) {
+            OrderHandle h = m_pool.alloc(Order{event.order_id, S, event.price, quantity_remaining, event.seq});
+            if (m_order_index.insert(event.order_id, h)) {
+                Level& level = side_book<S>()[event.price];
+                m_pool.push_back(level.queue, h, quantity_remaining);
+                level.quantity += quantity_remaining;
+                level.orders++;
+                touch(S, event.price);
+                if (event.expire_time) m_pool.timer(h) = m_timers.add(event.expire_time, event.order_id);
+                m_owners.add(event.owner, h);
             }
-            m_best_buy_it = (it == m_buy_book.end()) ? m_buy_book.rbegin() : BuyRIt(it);
+            else m_pool.free(h);
         }
-        return false;
+
+        return true;
     }
 
-    // Non-cache aware best price functions, scans every time
-    bool find_best_sell_price(Price& return_price) {
-        std::vector<Price> toDelete;
-        bool ret {false};
-    
-        for (auto price = m_sell_book.begin(); price != m_sell_book.end(); price++) {
-            // iterate from lowest to highest
-            // remove inactive orders
-            auto& q = (price->second);
-            while (!q.empty() && !m_order_index.at(q.front()).active) {
-                m_order_index.erase(q.front());
-                q.pop_front();
-            };
-            // return best sell price
-            if (!q.empty()) {
-                return_price = price->first;
-                ret = true;
-                break;
+    template <Side S>
+    auto& side_book() {
+        if constexpr (S == Side::Buy) return m_buy_book;
+        else return m_sell_book;
+    }
+
+    bool cancel(const OrderId id) {
+        OrderHandle h = m_order_index.erase(id);
+        if (h == null_handle) return false;
+        if (m_pool.side(h) == Side::Buy) remove_order(m_buy_book, h);
+        else remove_order(m_sell_book, h);
+        return true;
+    }
+
+    bool replace(const Event& event, Timestamp now) {
+        OrderHandle h = m_order_index.find(event.order_id);
+        if (h == null_handle) return false;
+
+        Side side = m_pool.side(h);
+        Price price = m_pool.price(h);
+        Level& level = (side == Side::Buy) ? *m_buy_book.find(price) : *m_sell_book.find(price);
+        int32_t& quantity = m_pool.quantity(level.queue, h);
+        if (event.side == side && event.price == price && event.tif == TimeInForce::GTC
+            && event.quantity > 0 && event.quantity <= quantity) {
+            level.quantity -= quantity - event.quantity;
+            quantity = event.quantity;
+            touch(event.side, event.price);
+
+            m_timers.cancel(m_pool.timer(h));
+            m_pool.timer(h) = event.expire_time ? m_timers.add(event.expire_time, event.order_id) : TWHandle{};
+            return true;
+        }
+
+        // the order keeps its owner whatever the replace event carries
+        Event entry = event;
+        entry.owner = m_owners.owner(h);
+        cancel(event.order_id);
+        return add(entry, now);
+    }
+
+    // remember a level changed by the current event, a sweep touches the same level back to back
+    void touch(Side side, Price price) {
+        if constexpr (publishes_depth<Depth>) {
+            if (m_dirty.empty() || m_dirty.back().side != side || m_dirty.back().price != price) m_dirty.push_back({price, 0, 0, side});
+        }
+    }
+
+    // one delta per level changed since the last call, with the level's final state
+    void publish_depth() {
+        if constexpr (publishes_depth<Depth>) {
+            if (m_dirty.size() > 1) {
+                auto key = [](const LevelDelta& d) { return std::pair(d.side, d.price); };
+                std::sort(m_dirty.begin(), m_dirty.end(), [&](const LevelDelta& a, const LevelDelta& b) { return key(a) < key(b); });
+                m_dirty.erase(std::unique(m_dirty.begin(), m_dirty.end(), [&](const LevelDelta& a, const LevelDelta& b) { return key(a) == key(b); }), m_dirty.end());
             }
-            else {
-                toDelete.emplace_back(price->first);
+            for (LevelDelta& d : m_dirty) {
+                const Level* level = (d.side == Side::Buy) ? m_buy_book.find(d.price) : m_sell_book.find(d.price);
+                if (level) {
+                    d.quantity = level->quantity;
+                    d.orders = level->orders;
+                }
+                m_depth.on_level(d);
             }
+            m_dirty.clear();
         }
-    
-        clean_book(m_sell_book, toDelete);
-        return ret;
     }
-    
-    bool find_best_buy_price(Price& return_price) {
-        std::vector<Price> toDelete;
-        bool ret {false};
-    
-        for (auto price = m_buy_book.rbegin(); price != m_buy_book.rend(); price++) {
-            // iterate from highest to lowest
-            // remove inactive orders
-            auto& q = (price->second);
-            while (!q.empty() && !m_order_index.at(q.front()).active) {
-                m_order_index.erase(q.front());
-                q.pop_front();
-            };
-            // return best sell price
-            if (!q.empty()) {
-                return_price = price->first;
-                ret = true;
-                break;
+
+    template <class Book>
+    void remove_order(Book& book, OrderHandle h) {
+        Price price = m_pool.price(h);
+        Level& level = *book.find(price);
+        release_order(level, h);
+        touch(Book::side, price);
+        if (level.empty()) book.erase(price);
+    }
+
+    template <class Book>
+    static size_t top_levels(const Book& book, std::span<LevelDepth> out) {
+        size_t n {0};
+        Price price;
+        for (const Level* level = book.best(price); level && n < out.size(); level = book.next(price)) {
+            out[n++] = {price, level->quantity, level->orders};
+        }
+        return n;
+    }
+
+    template <class Book>
+    void capture_levels(const Book& book, BookSnapshot& out) const {
+        book.for_each([&](Price price, const Level& level) {
+            out.levels.push_back({price, level.orders, level.quantity});
+            m_pool.for_each_handle(level.queue, [&](OrderHandle h) {
+                out.orders.push_back({m_pool.order_id(h), m_pool.seq_new(h), m_timers.expiry(m_pool.timer(h)), m_pool.quantity(level.queue, h), m_owners.owner(h)});
+            });
+        });
+    }
+
+    // everything restore can check before touching the book, only duplicate ids are left to the index
+    static void check_snapshot(const SnapshotView& snap) {
+        size_t first {0};
+        for (std::span<const SnapshotLevel> levels : {snap.sell_levels, snap.buy_levels}) {
+            for (const SnapshotLevel& l : levels) {
+                if (l.orders == 0 || snap.orders.size() - first < l.orders) throw std::runtime_error("OrderBook::restore: bad level");
+                int64_t quantity {0};
+                for (const SnapshotOrder& o : snap.orders.subspan(first, l.orders)) {
+                    if (o.quantity_remaining <= 0) throw std::runtime_error("OrderBook::restore: bad order quantity");
+                    quantity += o.quantity_remaining;
+                }
+                if (quantity != l.quantity) throw std::runtime_error("OrderBook::restore: level quantity does not match orders");
+                first += l.orders;
             }
-            else {
-                toDelete.emplace_back(price->first);
+        }
+        if (first != snap.orders.size()) throw std::runtime_error("OrderBook::restore: order count does not match levels");
+    }
+
+    // levels arrive best to worst and each FIFO in order, so every order is a push_back
+    // returns the offset of the first order past these levels
+    template <class Book>
+    size_t restore_levels(Book& book, std::span<const SnapshotLevel> levels, std::span<const SnapshotOrder> orders, size_t first) {
+        for (const SnapshotLevel& l : levels) {
+            Level& level = book[l.price];
+            for (const SnapshotOrder& o : orders.subspan(first, l.orders)) {
+                OrderHandle h = m_pool.alloc(Order{o.order_id, Book::side, l.price, o.quantity_remaining, o.seq_new});
+                if (!m_order_index.insert(o.order_id, h)) {
+                    m_pool.free(h);
+                    if (level.empty()) book.erase(l.price);
+                    throw std::runtime_error("OrderBook::restore: duplicate order id");
+                }
+                m_pool.push_back(level.queue, h, o.quantity_remaining);
+                level.quantity += o.quantity_remaining;
+                level.orders++;
+                if (o.expire_time) m_pool.timer(h) = m_timers.add(o.expire_time, o.order_id);
+                m_owners.add(o.owner, h);
             }
+            first += l.orders;
         }
-    
-        clean_book(m_buy_book, toDelete);
-        return ret;
+        return first;
+    }
+
+    // true if the resting side holds at least quantity at prices crossing limit, reads level totals only
+    template <class Book>
+    bool can_fill(const Book& book, Price limit, int64_t quantity) const {
+        Price price;
+        for (const Level* level = book.best(price); level && quantity > 0; level = book.next(price)) {
+            if (better_price<Book::side>(limit, price)) break;
+            quantity -= level->quantity;
+        }
+        return quantity <= 0;
+    }
+
+    // unlink from the level FIFO, take its remaining quantity off the level totals,
+    // drop any expiry timer and return the slot
+    void release_order(Level& level, OrderHandle h) {
+        level.quantity -= m_pool.quantity(level.queue, h);
+        m_pool.unlink(level.queue, h);
+        retire_order(level, h);
+    }
+
+    // makers a sweep took off the level in full: their trades go to the sink in one call, then
+    // the run is retired one structure at a time, timers and owner links only if the book holds any
+    template <class Traits>
+    void fill_run(Level& level, OrderId taker, Price price, std::span<const OrderHandle> handles,
+                  std::span<const OrderId> makers, std::span<const int32_t> quantities, Timestamp now) {
+        if (m_fills.size() < handles.size()) m_fills.resize(handles.size());
+        size_t n {0};
+        for (size_t i = 0; i < handles.size(); i++) {
+            if (handles[i] == null_handle) continue;
+            m_fills[n++] = Traits::trade(taker, makers[i], price, quantities[i], now);
+        }
+        m_sink.on_trades(std::span<const Trade>(m_fills.data(), n));
+        level.orders -= static_cast<uint32_t>(n);
+
+        // index slots of a long run are scattered, fetch a few makers ahead
+        constexpr size_t ahead = 8;
+        for (size_t i = 0; i < handles.size(); i++) {
+            if (i + ahead < handles.size()) m_order_index.prefetch(makers[i + ahead]);
+            if (handles[i] != null_handle) m_order_index.erase(makers[i]);
+        }
+        if (m_timers.size()) for (OrderHandle h : handles) if (h != null_handle) m_timers.cancel(m_pool.timer(h));
+        if (m_owners.size()) for (OrderHandle h : handles) if (h != null_handle) m_owners.remove(h);
+        m_pool.free(handles);
     }
-};
 
+    // order already off the FIFO with nothing left: count it out, drop any timer and owner link,
+    // return the slot
+    void retire_order(Level& level, OrderHandle h) {
+        level.orders--;
+        m_timers.cancel(m_pool.timer(h));
+        m_owners.remove(h);
+        m_pool.free(h);
+    }
+};
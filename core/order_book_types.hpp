@@ -1,50 +1,74 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
-#include <chrono>
 #include <atomic>
 
+#include "latency_histogram.hpp"
+
 using OrderId = uint64_t;
 using Price = uint32_t;
-using Timestamp = std::chrono::steady_clock::time_point;
+using Timestamp = uint64_t; // ns, from TscClock::now() (steady_clock epoch)
+using InstrumentId = uint32_t;
+using OwnerId = uint32_t; // participant or session, 0 = none
 
-enum class Side {
+enum class Side : uint8_t {
     Buy,
     Sell
 };
 
-enum class Type {
+enum class TimeInForce : uint8_t {
+    GTC, // rest any remainder (until expire_time if set)
+    IOC, // fill what crosses now, discard the remainder
+    FOK  // fill the whole quantity now or do nothing
+};
+
+enum class Type : uint8_t {
     New,
     Cancel,
-    Replace
+    Replace,
+    MassCancel // every resting order of owner
 };
 
 // event coming from the exchange
+// 64 bit fields first, then 32 bit, then the one byte enums, so there is no interior padding
+// seq, id and two ns timestamps alone are 32 bytes, 56 is as small as it gets without
+// dropping a field (8 events per 7 cache lines)
 struct Event {
     uint64_t seq;
-    Type type;
     OrderId order_id;
-    Side side;
+    Timestamp timestamp_in;
+    // good till time, ns on the timestamp_in clock, 0 = good till cancelled, see OrderBook::on_new
+    uint64_t expire_time {0};
     Price price;
     int32_t quantity;
-    Timestamp timestamp_in;
+    // routes the event to its book, see ShardedEngine
+    InstrumentId instrument {0};
+    // owner of the order, or whose orders a MassCancel pulls, see OrderBook::on_mass_cancel
+    OwnerId owner {0};
+    Type type;
+    Side side;
+    TimeInForce tif {TimeInForce::GTC};
 };
+static_assert(sizeof(Event) == 56 && alignof(Event) == 8);
+static_assert(offsetof(Event, tif) == 50, "Event has interior padding");
 
 // currently active order sitting in the book
 struct Order {
     OrderId order_id;
-    Side side;
+    uint64_t seq_new;
     Price price;
     int32_t quantity_remaining;
-    uint64_t seq_new;
-    bool active;
+    Side side;
 
-    Order (OrderId o, Side s, Price p, int32_t q, uint64_t se, bool a):
-    order_id{o}, side{s}, price{p}, quantity_remaining{q}, seq_new{se}, active{a}
+    Order () = default;
+    Order (OrderId o, Side s, Price p, int32_t q, uint64_t se):
+    order_id{o}, seq_new{se}, price{p}, quantity_remaining{q}, side{s}
     {}
 };
+static_assert(sizeof(Order) == 32 && alignof(Order) == 8);
 
-// fill between two orders
+// fill between two orders, two per cache line
 struct Trade {
     OrderId seller_id;
     OrderId buyer_id;
@@ -52,16 +76,26 @@ struct Trade {
     int32_t quantity;
     Timestamp timestamp_exec;
 
+    Trade () = default;
     Trade (OrderId s, OrderId (b), Price p, int32_t q, Timestamp ts): 
     seller_id{s}, buyer_id{b}, price{p}, quantity{q}, timestamp_exec{ts} 
     {}
 };
+static_assert(sizeof(Trade) == 32 && alignof(Trade) == 8);
 
-// used for quick lookup
-struct OrderMeta {
+// aggregate view of one price level
+struct LevelDepth {
     Price price;
-    size_t fifo_idx;
-    bool active;
+    int64_t quantity;
+    uint32_t orders;
+};
+
+// new state of one price level after an event, zero quantity and orders means the level is gone
+struct LevelDelta {
+    Price price;
+    uint32_t orders;
+    int64_t quantity;
+    Side side;
 };
 
 struct BookStats {
@@ -75,5 +109,5 @@ struct BookStats {
     size_t consumed_cancel = 0;
     size_t consumed_replace = 0;
 
-    std::vector<uint64_t> latencies_ns;
+    LatencyHistogram latency_ns;
 };
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "order_book_types.hpp"
+#include "order_pool.hpp"
+
+// Index interface, OrderId -> pool handle
+//   bool insert(OrderId, OrderHandle)   false if the id is already present
+//   OrderHandle find(OrderId)           null_handle if absent
+//   OrderHandle erase(OrderId)          removed handle, null_handle if absent
+//   void prefetch(OrderId)              hint that id is looked up soon, may do nothing
+//   size_t bytes()                      memory held, see OrderBook::memory_stats
+
+// node based table, one allocation per insert
+class StdOrderIndex {
+    std::unordered_map<OrderId, OrderHandle> m_map;
+
+    public:
+
+    explicit StdOrderIndex(size_t capacity) { m_map.reserve(capacity); }
+
+    bool insert(OrderId id, OrderHandle h) { return m_map.try_emplace(id, h).second; }
+
+    OrderHandle find(OrderId id) const {
+        auto it = m_map.find(id);
+        return it == m_map.end() ? null_handle : it->second;
+    }
+
+    OrderHandle erase(OrderId id) {
+        auto it = m_map.find(id);
+        if (it == m_map.end()) return null_handle;
+        OrderHandle h = it->second;
+        m_map.erase(it);
+        return h;
+    }
+
+    void prefetch(OrderId) const {}
+
+    size_t size() const { return m_map.size(); }
+
+    // bucket array plus one node (entry and next pointer) per entry, allocator overhead not counted
+    size_t bytes() const {
+        return m_map.bucket_count() * sizeof(void*) + m_map.size() * (sizeof(std::pair<const OrderId, OrderHandle>) + sizeof(void*));
+    }
+};
+
+// open addressing with linear probing, erase shifts the run back so there are no tombstones
+// kept at most half full, grows by doubling (only when the live set outgrows the capacity)
+class LinearProbeIndex {
+    static constexpr OrderId empty_key = UINT64_MAX;
+
+    struct Slot {
+        OrderId key;
+        OrderHandle handle;
+    };
+
+    std::vector<Slot> m_slots;
+    size_t m_mask;
+    size_t m_size {0};
+
+    // fibonacci hashing, sequential ids land on spread out slots
+    size_t home(OrderId id) const { return (id * 0x9E3779B97F4A7C15ull) >> 32 & m_mask; }
+
+    public:
+
+    explicit LinearProbeIndex(size_t capacity):
+    m_slots(std::bit_ceil(std::max<size_t>(capacity * 2, 16)), Slot{empty_key, null_handle}),
+    m_mask(m_slots.size() - 1)
+    {}
+
+    bool insert(OrderId id, OrderHandle h) {
+        if ((m_size + 1) * 2 > m_slots.size()) grow();
+        size_t i = home(id);
+        while (m_slots[i].key != empty_key) {
+            if (m_slots[i].key == id) return false;
+            i = (i + 1) & m_mask;
+        }
+        m_slots[i] = {id, h};
+        m_size++;
+        return true;
+    }
+
+    OrderHandle find(OrderId id) const {
+        for (size_t i = home(id); m_slots[i].key != empty_key; i = (i + 1) & m_mask) {
+            if (m_slots[i].key == id) return m_slots[i].handle;
+        }
+        return null_handle;
+    }
+
+    OrderHandle erase(OrderId id) {
+        size_t i = home(id);
+        while (m_slots[i].key != id) {
+            if (m_slots[i].key == empty_key) return null_handle;
+            i = (i + 1) & m_mask;
+        }
+        OrderHandle h = m_slots[i].handle;
+        m_size--;
+
+        // backward shift: pull later entries of the run into the hole if their home allows it
+        size_t hole = i;
+        for (size_t j = (i + 1) & m_mask; m_slots[j].key != empty_key; j = (j + 1) & m_mask) {
+            size_t k = home(m_slots[j].key);
+            // entry at j may move to hole unless its home lies cyclically in (hole, j]
+            bool stays = (hole <= j) ? (hole < k && k <= j) : (hole < k || k <= j);
+            if (!stays) {
+                m_slots[hole] = m_slots[j];
+                hole = j;
+            }
+        }
+        m_slots[hole] = {empty_key, null_handle};
+        return h;
+    }
+
+    void prefetch(OrderId id) const { __builtin_prefetch(&m_slots[home(id)], 1); }
+
+    size_t size() const { return m_size; }
+    size_t bytes() const { return m_slots.capacity() * sizeof(Slot); }
+
+    private:
+
+    void grow() {
+        std::vector<Slot> old(m_slots.size() * 2, Slot{empty_key, null_handle});
+        old.swap(m_slots);
+        m_mask = m_slots.size() - 1;
+        m_size = 0;
+        for (const Slot& s : old) if (s.key != empty_key) insert(s.key, s.handle);
+    }
+};
+
+// direct indexed by id modulo the window, ids arrive almost in order so live orders rarely share a slot
+// an old order still resting when a newer id claims its slot is moved to the overflow table
+class WindowIndex {
+    static constexpr OrderId empty_key = UINT64_MAX;
+
+    struct Slot {
+        OrderId key;
+        OrderHandle handle;
+    };
+
+    std::vector<Slot> m_slots;
+    size_t m_mask;
+    size_t m_size {0};
+    LinearProbeIndex m_overflow;
+
+    public:
+
+    explicit WindowIndex(size_t capacity):
+    m_slots(std::bit_ceil(std::max<size_t>(capacity, 16)), Slot{empty_key, null_handle}),
+    m_mask(m_slots.size() - 1),
+    m_overflow(m_slots.size() / 8)
+    {}
+
+    bool insert(OrderId id, OrderHandle h) {
+        Slot& s = m_slots[id & m_mask];
+        if (s.key == id) return false;
+        if (m_overflow.size() && m_overflow.find(id) != null_handle) return false;
+        if (s.key != empty_key) m_overflow.insert(s.key, s.handle);
+        s = {id, h};
+        m_size++;
+        return true;
+    }
+
+    OrderHandle find(OrderId id) const {
+        const Slot& s = m_slots[id & m_mask];
+        if (s.key == id) return s.handle;
+        return m_overflow.size() ? m_overflow.find(id) : null_handle;
+    }
+
+    OrderHandle erase(OrderId id) {
+        Slot& s = m_slots[id & m_mask];
+        if (s.key == id) {
+            OrderHandle h = s.handle;
+            s = {empty_key, null_handle};
+            m_size--;
+            return h;
+        }
+        if (!m_overflow.size()) return null_handle;
+        OrderHandle h = m_overflow.erase(id);
+        if (h != null_handle) m_size--;
+        return h;
+    }
+
+    void prefetch(OrderId id) const { __builtin_prefetch(&m_slots[id & m_mask], 1); }
+
+    size_t size() const { return m_size; }
+    size_t bytes() const { return m_slots.capacity() * sizeof(Slot) + m_overflow.bytes(); }
+};
@@ -0,0 +1,326 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "hierarchical_timer_wheel.hpp"
+#include "page_allocator.hpp"
+#include "order_book_types.hpp"
+
+using OrderHandle = uint32_t;
+constexpr OrderHandle null_handle = UINT32_MAX;
+
+// pool slot, prev/next link the order into its price level FIFO
+// a free slot reuses next as the free list link
+struct OrderNode {
+    Order order;
+    OrderHandle prev;
+    OrderHandle next;
+    TWHandle timer; // expiry timer of a good till time order
+};
+
+// price level FIFO, intrusive doubly linked list through the pool
+struct OrderQueue {
+    OrderHandle head {null_handle};
+    OrderHandle tail {null_handle};
+
+    bool empty() const { return head == null_handle; }
+    void clear() { head = tail = null_handle; }
+};
+
+// resting orders at one price, FIFO plus running total quantity and live order count
+// the FIFO layout belongs to the pool, Queue is Pool::Queue
+template <class Queue>
+struct BasicPriceLevel {
+    Queue queue;
+    int64_t quantity {0};
+    uint32_t orders {0};
+
+    bool empty() const { return queue.empty(); }
+    void clear() { queue.clear(); quantity = 0; orders = 0; }
+};
+
+using PriceLevel = BasicPriceLevel<OrderQueue>;
+
+// Pool interface (OrderPool, SoaOrderPool or SweepOrderPool), resting orders addressed by handle
+//   Queue                                  FIFO of one price level
+//   OrderHandle alloc(const Order&), void free(OrderHandle), size_t live(), size_t capacity()
+//   void free(std::span<const OrderHandle>) free a run, null_handle entries are skipped
+//   order_id(h), side(h), price(h), seq_new(h), TWHandle& timer(h)
+//   int32_t& quantity(Queue&, h)           remaining quantity of h resting in that FIFO
+//   push_back(Queue&, h, quantity), unlink(Queue&, h)
+//   int32_t fill(Queue&, quantity, run(handles, order_ids, quantities), partial(h, filled))
+//                                          fill up to quantity from the front in FIFO order, run sees
+//                                          each run of makers filled in full (already off the FIFO,
+//                                          run must free them, null_handle entries are holes with
+//                                          quantity 0), partial the one maker left with a remainder,
+//                                          returns the quantity filled
+//   for_each(const Queue&, f(const Order&)), for_each_handle(const Queue&, f(h)) visit a FIFO in order
+//   size_t bytes()                         memory held by the pool
+//   size_t bytes(const Queue&), size_t dead(const Queue&)
+//                                          memory held by one FIFO and cancelled slots it still holds
+
+// slab of order nodes addressed by handle, preallocated up front
+// running past capacity grows the slab, handles stay valid but references do not
+class OrderPool {
+    std::vector<OrderNode, PageAllocator<OrderNode>> m_nodes;
+    OrderHandle m_free {null_handle};
+    size_t m_live {0};
+
+    public:
+
+    using Queue = OrderQueue;
+
+    explicit OrderPool(size_t capacity, const MemoryPolicy& memory = {}): m_nodes(PageAllocator<OrderNode>(memory)) {
+        m_nodes.resize(capacity);
+        for (size_t i = capacity; i-- > 0;) release_slot(static_cast<OrderHandle>(i));
+    }
+
+    OrderHandle alloc(const Order& order) {
+        if (m_free == null_handle) {
+            m_nodes.emplace_back();
+            release_slot(static_cast<OrderHandle>(m_nodes.size() - 1));
+        }
+        OrderHandle h = m_free;
+        m_free = m_nodes[h].next;
+        m_nodes[h] = {order, null_handle, null_handle, TWHandle{}};
+        m_live++;
+        return h;
+    }
+
+    void free(OrderHandle h) {
+        release_slot(h);
+        m_live--;
+    }
+
+    void free(std::span<const OrderHandle> handles) {
+        for (OrderHandle h : handles) if (h != null_handle) free(h);
+    }
+
+    Order& operator[](OrderHandle h) { return m_nodes[h].order; }
+    const Order& operator[](OrderHandle h) const { return m_nodes[h].order; }
+
+    OrderId order_id(OrderHandle h) const { return m_nodes[h].order.order_id; }
+    Side side(OrderHandle h) const { return m_nodes[h].order.side; }
+    Price price(OrderHandle h) const { return m_nodes[h].order.price; }
+    uint64_t seq_new(OrderHandle h) const { return m_nodes[h].order.seq_new; }
+    int32_t& quantity(OrderQueue&, OrderHandle h) { return m_nodes[h].order.quantity_remaining; }
+    int32_t quantity(const OrderQueue&, OrderHandle h) const { return m_nodes[h].order.quantity_remaining; }
+
+    size_t live() const { return m_live; }
+    size_t capacity() const { return m_nodes.size(); }
+
+    // the FIFO links live in the nodes, a cancel unlinks at once
+    size_t bytes() const { return m_nodes.capacity() * sizeof(OrderNode); }
+    size_t bytes(const OrderQueue&) const { return 0; }
+    size_t dead(const OrderQueue&) const { return 0; }
+
+    void push_back(OrderQueue& q, OrderHandle h, int32_t quantity) {
+        m_nodes[h].order.quantity_remaining = quantity;
+        m_nodes[h].prev = q.tail;
+        m_nodes[h].next = null_handle;
+        if (q.tail == null_handle) q.head = h;
+        else m_nodes[q.tail].next = h;
+        q.tail = h;
+    }
+
+    void unlink(OrderQueue& q, OrderHandle h) {
+        OrderNode& n = m_nodes[h];
+        if (n.prev == null_handle) q.head = n.next;
+        else m_nodes[n.prev].next = n.next;
+        if (n.next == null_handle) q.tail = n.prev;
+        else m_nodes[n.next].prev = n.prev;
+    }
+
+    // one maker at a time down the list, every run is a single maker
+    template <class Run, class Partial>
+    int32_t fill(OrderQueue& q, int32_t quantity, Run&& run, Partial&& partial) {
+        int32_t filled {0};
+        while (filled < quantity && !q.empty()) {
+            OrderHandle h = q.head;
+            int32_t& maker = m_nodes[h].order.quantity_remaining;
+            if (maker > quantity - filled) {
+                maker -= quantity - filled;
+                partial(h, quantity - filled);
+                return quantity;
+            }
+            filled += maker;
+            unlink(q, h);
+            run(std::span<const OrderHandle>(&h, 1), std::span<const OrderId>(&m_nodes[h].order.order_id, 1), std::span<const int32_t>(&maker, 1));
+        }
+        return filled;
+    }
+
+    OrderHandle next(OrderHandle h) const { return m_nodes[h].next; }
+    TWHandle& timer(OrderHandle h) { return m_nodes[h].timer; }
+    TWHandle timer(OrderHandle h) const { return m_nodes[h].timer; }
+
+    template <class F>
+    void for_each(const OrderQueue& q, F&& f) const {
+        for (OrderHandle h = q.head; h != null_handle; h = m_nodes[h].next) f(m_nodes[h].order);
+    }
+
+    template <class F>
+    void for_each_handle(const OrderQueue& q, F&& f) const {
+        for (OrderHandle h = q.head; h != null_handle; h = m_nodes[h].next) f(h);
+    }
+
+    private:
+
+    void release_slot(OrderHandle h) {
+        m_nodes[h].next = m_free;
+        m_free = h;
+    }
+};
+
+// same pool with one array per field, a sweep down a level FIFO only pulls the next
+// links, quantities and ids into cache, the rest stays cold until an order is amended
+// or cancelled
+class SoaOrderPool {
+    template <class T>
+    using Column = std::vector<T, PageAllocator<T>>;
+
+    Column<OrderHandle> m_next;
+    Column<int32_t> m_quantity;
+    Column<OrderId> m_order_id;
+    Column<OrderHandle> m_prev;
+    Column<Price> m_price;
+    Column<Side> m_side;
+    Column<uint64_t> m_seq_new;
+    Column<TWHandle> m_timer;
+    OrderHandle m_free {null_handle};
+    size_t m_live {0};
+
+    public:
+
+    using Queue = OrderQueue;
+
+    explicit SoaOrderPool(size_t capacity, const MemoryPolicy& memory = {}):
+    m_next(PageAllocator<OrderHandle>(memory)),
+    m_quantity(PageAllocator<int32_t>(memory)),
+    m_order_id(PageAllocator<OrderId>(memory)),
+    m_prev(PageAllocator<OrderHandle>(memory)),
+    m_price(PageAllocator<Price>(memory)),
+    m_side(PageAllocator<Side>(memory)),
+    m_seq_new(PageAllocator<uint64_t>(memory)),
+    m_timer(PageAllocator<TWHandle>(memory))
+    {
+        resize(capacity);
+        for (size_t i = capacity; i-- > 0;) release_slot(static_cast<OrderHandle>(i));
+    }
+
+    OrderHandle alloc(const Order& order) {
+        if (m_free == null_handle) {
+            resize(m_next.size() + 1);
+            release_slot(static_cast<OrderHandle>(m_next.size() - 1));
+        }
+        OrderHandle h = m_free;
+        m_free = m_next[h];
+        m_next[h] = m_prev[h] = null_handle;
+        m_quantity[h] = order.quantity_remaining;
+        m_order_id[h] = order.order_id;
+        m_price[h] = order.price;
+        m_side[h] = order.side;
+        m_seq_new[h] = order.seq_new;
+        m_timer[h] = TWHandle{};
+        m_live++;
+        return h;
+    }
+
+    void free(OrderHandle h) {
+        release_slot(h);
+        m_live--;
+    }
+
+    void free(std::span<const OrderHandle> handles) {
+        for (OrderHandle h : handles) if (h != null_handle) free(h);
+    }
+
+    OrderId order_id(OrderHandle h) const { return m_order_id[h]; }
+    Side side(OrderHandle h) const { return m_side[h]; }
+    Price price(OrderHandle h) const { return m_price[h]; }
+    uint64_t seq_new(OrderHandle h) const { return m_seq_new[h]; }
+    int32_t& quantity(OrderQueue&, OrderHandle h) { return m_quantity[h]; }
+    int32_t quantity(const OrderQueue&, OrderHandle h) const { return m_quantity[h]; }
+
+    size_t live() const { return m_live; }
+    size_t capacity() const { return m_next.size(); }
+
+    size_t bytes() const {
+        return m_next.capacity() * sizeof(OrderHandle) + m_quantity.capacity() * sizeof(int32_t)
+            + m_order_id.capacity() * sizeof(OrderId) + m_prev.capacity() * sizeof(OrderHandle)
+            + m_price.capacity() * sizeof(Price) + m_side.capacity() * sizeof(Side)
+            + m_seq_new.capacity() * sizeof(uint64_t) + m_timer.capacity() * sizeof(TWHandle);
+    }
+    size_t bytes(const OrderQueue&) const { return 0; }
+    size_t dead(const OrderQueue&) const { return 0; }
+
+    void push_back(OrderQueue& q, OrderHandle h, int32_t quantity) {
+        m_quantity[h] = quantity;
+        m_prev[h] = q.tail;
+        m_next[h] = null_handle;
+        if (q.tail == null_handle) q.head = h;
+        else m_next[q.tail] = h;
+        q.tail = h;
+    }
+
+    void unlink(OrderQueue& q, OrderHandle h) {
+        if (m_prev[h] == null_handle) q.head = m_next[h];
+        else m_next[m_prev[h]] = m_next[h];
+        if (m_next[h] == null_handle) q.tail = m_prev[h];
+        else m_prev[m_next[h]] = m_prev[h];
+    }
+
+    template <class Run, class Partial>
+    int32_t fill(OrderQueue& q, int32_t quantity, Run&& run, Partial&& partial) {
+        int32_t filled {0};
+        while (filled < quantity && !q.empty()) {
+            OrderHandle h = q.head;
+            if (m_quantity[h] > quantity - filled) {
+                m_quantity[h] -= quantity - filled;
+                partial(h, quantity - filled);
+                return quantity;
+            }
+            filled += m_quantity[h];
+            unlink(q, h);
+            run(std::span<const OrderHandle>(&h, 1), std::span<const OrderId>(&m_order_id[h], 1), std::span<const int32_t>(&m_quantity[h], 1));
+        }
+        return filled;
+    }
+
+    OrderHandle next(OrderHandle h) const { return m_next[h]; }
+    TWHandle& timer(OrderHandle h) { return m_timer[h]; }
+    TWHandle timer(OrderHandle h) const { return m_timer[h]; }
+
+    template <class F>
+    void for_each(const OrderQueue& q, F&& f) const {
+        for (OrderHandle h = q.head; h != null_handle; h = m_next[h]) {
+            f(Order{m_order_id[h], m_side[h], m_price[h], m_quantity[h], m_seq_new[h]});
+        }
+    }
+
+    template <class F>
+    void for_each_handle(const OrderQueue& q, F&& f) const {
+        for (OrderHandle h = q.head; h != null_handle; h = m_next[h]) f(h);
+    }
+
+    private:
+
+    void resize(size_t n) {
+        m_next.resize(n);
+        m_quantity.resize(n);
+        m_order_id.resize(n);
+        m_prev.resize(n);
+        m_price.resize(n);
+        m_side.resize(n);
+        m_seq_new.resize(n);
+        m_timer.resize(n);
+    }
+
+    void release_slot(OrderHandle h) {
+        m_next[h] = m_free;
+        m_free = h;
+    }
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "order_book_types.hpp"
+#include "order_index.hpp"
+#include "order_pool.hpp"
+
+// live orders of each owner, an intrusive doubly linked list through a link array indexed
+// by pool handle, so adding and removing an order is O(1) and a mass cancel visits only
+// that owner's orders
+// an owner with resting orders holds a slot in a dense table of list heads, the slot sits in
+// each order's link so removal never looks the owner up, and goes back once the list empties
+// owner 0 means no owner, those orders are not tracked
+class OwnerOrders {
+    static constexpr uint32_t null_list = UINT32_MAX;
+
+    struct Link {
+        OrderHandle prev {null_handle};
+        OrderHandle next {null_handle};
+        uint32_t list {null_list};
+    };
+
+    struct List {
+        OrderHandle head {null_handle};
+        OrderHandle tail {null_handle};
+        OwnerId owner {0};
+    };
+
+    std::vector<Link> m_links;
+    std::vector<List> m_lists;
+    std::vector<uint32_t> m_free_lists;
+    LinearProbeIndex m_list_of; // owner -> slot in m_lists, owners with resting orders only
+    size_t m_size {0};
+
+    public:
+
+    explicit OwnerOrders(size_t capacity, size_t owners = 256): m_links(capacity), m_list_of(owners) {}
+
+    void add(OwnerId owner, OrderHandle h) {
+        if (!owner) return;
+        if (h >= m_links.size()) m_links.resize(std::max<size_t>(h + 1, 2 * m_links.size()));
+        uint32_t slot = m_list_of.find(owner);
+        if (slot == null_handle) {
+            slot = acquire_list(owner);
+            m_list_of.insert(owner, slot);
+        }
+        List& list = m_lists[slot];
+        m_links[h] = {list.tail, null_handle, slot};
+        if (list.tail == null_handle) list.head = h;
+        else m_links[list.tail].next = h;
+        list.tail = h;
+        m_size++;
+    }
+
+    // no-op for an order without an owner
+    void remove(OrderHandle h) {
+        if (h >= m_links.size() || m_links[h].list == null_list) return;
+        Link& l = m_links[h];
+        List& list = m_lists[l.list];
+        if (l.prev == null_handle) list.head = l.next;
+        else m_links[l.prev].next = l.next;
+        if (l.next == null_handle) list.tail = l.prev;
+        else m_links[l.next].prev = l.prev;
+        if (list.head == null_handle) {
+            m_list_of.erase(list.owner);
+            m_free_lists.push_back(l.list);
+        }
+        l = Link{};
+        m_size--;
+    }
+
+    // orders with an owner
+    size_t size() const { return m_size; }
+
+    OwnerId owner(OrderHandle h) const {
+        return h < m_links.size() && m_links[h].list != null_list ? m_lists[m_links[h].list].owner : 0;
+    }
+
+    // oldest first, f may remove the order it is handed
+    template <class F>
+    void for_each(OwnerId owner, F&& f) {
+        uint32_t slot = m_list_of.find(owner);
+        if (slot == null_handle) return;
+        for (OrderHandle h = m_lists[slot].head; h != null_handle;) {
+            OrderHandle next = m_links[h].next;
+            f(h);
+            h = next;
+        }
+    }
+
+    size_t bytes() const {
+        return m_links.capacity() * sizeof(Link) + m_lists.capacity() * sizeof(List)
+            + m_free_lists.capacity() * sizeof(uint32_t) + m_list_of.bytes();
+    }
+
+    private:
+
+    uint32_t acquire_list(OwnerId owner) {
+        uint32_t slot;
+        if (m_free_lists.empty()) {
+            slot = static_cast<uint32_t>(m_lists.size());
+            m_lists.emplace_back();
+        }
+        else {
+            slot = m_free_lists.back();
+            m_free_lists.pop_back();
+        }
+        m_lists[slot] = {null_handle, null_handle, owner};
+        return slot;
+    }
+};
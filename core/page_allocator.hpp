@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// where and how large buffers (ring slots, order pool, flat ladder levels) get their memory
+// the default is the plain heap, anything else maps pages directly
+struct MemoryPolicy {
+    bool huge_pages {false}; // MAP_HUGETLB, falling back to a transparent huge page hint
+    bool prefault {false};   // touch every page up front so no fault lands on the hot path
+    bool lock {false};       // mlock, skipped if RLIMIT_MEMLOCK refuses
+    int numa_node {-1};      // bind to this node, -1 leaves placement to first touch
+
+    bool mapped() const { return huge_pages || prefault || lock || numa_node >= 0; }
+};
+
+// what a mapping actually got, every step falls back silently
+struct PageMapping {
+    void* addr {nullptr};
+    size_t len {0};
+    bool huge {false};   // backed by MAP_HUGETLB pages
+    bool thp {false};    // MADV_HUGEPAGE accepted
+    bool bound {false};  // mbind to the node succeeded
+    bool locked {false}; // mlock succeeded
+};
+
+inline constexpr size_t huge_page_size = size_t{2} << 20;
+
+// node of the cpu the caller is running on, run it on the consumer thread
+inline int current_numa_node() {
+    unsigned cpu = 0, node = 0;
+    if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return -1;
+    return static_cast<int>(node);
+}
+
+namespace page_detail {
+
+inline size_t page_size() {
+    static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+inline size_t round_up(size_t n, size_t align) { return (n + align - 1) / align * align; }
+
+// mapping length for bytes under policy, the same on map and unmap
+inline size_t mapped_len(size_t bytes, const MemoryPolicy& policy) {
+    return round_up(bytes ? bytes : 1, policy.huge_pages ? huge_page_size : page_size());
+}
+
+}
+
+inline PageMapping map_pages(size_t bytes, const MemoryPolicy& policy) {
+    PageMapping m;
+    m.len = page_detail::mapped_len(bytes, policy);
+
+    if (policy.huge_pages) {
+        void* p = ::mmap(nullptr, m.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            m.addr = p;
+            m.huge = true;
+        }
+    }
+    if (!m.addr) {
+        // over map and trim to a huge page boundary, so the THP hint can actually be honoured
+        size_t align = policy.huge_pages ? huge_page_size : page_detail::page_size();
+        size_t over = m.len + align - page_detail::page_size();
+        void* p = ::mmap(nullptr, over, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) throw std::bad_alloc();
+        char* base = static_cast<char*>(p);
+        char* aligned = reinterpret_cast<char*>(page_detail::round_up(reinterpret_cast<uintptr_t>(base), align));
+        if (aligned > base) ::munmap(base, aligned - base);
+        if (base + over > aligned + m.len) ::munmap(aligned + m.len, base + over - (aligned + m.len));
+        m.addr = aligned;
+        if (policy.huge_pages) m.thp = ::madvise(m.addr, m.len, MADV_HUGEPAGE) == 0;
+    }
+
+    // placement is decided at first touch, so bind before prefaulting
+    if (policy.numa_node >= 0 && policy.numa_node < 64) {
+        unsigned long mask = 1ul << policy.numa_node;
+        m.bound = ::syscall(SYS_mbind, m.addr, m.len, MPOL_BIND, &mask, sizeof(mask) * 8, 0) == 0;
+    }
+    if (policy.prefault) {
+        volatile char* p = static_cast<volatile char*>(m.addr);
+        for (size_t off = 0; off < m.len; off += page_detail::page_size()) p[off] = 0;
+    }
+    if (policy.lock) m.locked = ::mlock(m.addr, m.len) == 0;
+    return m;
+}
+
+inline void unmap_pages(void* addr, size_t bytes, const MemoryPolicy& policy) {
+    ::munmap(addr, page_detail::mapped_len(bytes, policy));
+}
+
+// std allocator over MemoryPolicy, plain operator new unless the policy asks for mapped pages
+// meant for a few large long lived buffers, each mapped allocation is at least a page
+template <class T>
+class PageAllocator {
+    template <class U>
+    friend class PageAllocator;
+
+    MemoryPolicy m_policy;
+
+    public:
+
+    using value_type = T;
+
+    PageAllocator() = default;
+    explicit PageAllocator(const MemoryPolicy& policy): m_policy(policy) {}
+
+    template <class U>
+    PageAllocator(const PageAllocator<U>& other): m_policy(other.m_policy) {}
+
+    T* allocate(size_t n) {
+        if (!m_policy.mapped()) return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(map_pages(n * sizeof(T), m_policy).addr);
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (!m_policy.mapped()) ::operator delete(p);
+        else unmap_pages(p, n * sizeof(T), m_policy);
+    }
+
+    const MemoryPolicy& policy() const { return m_policy; }
+
+    template <class U>
+    bool operator==(const PageAllocator<U>& other) const {
+        const MemoryPolicy& a = m_policy;
+        const MemoryPolicy& b = other.m_policy;
+        return a.huge_pages == b.huge_pages && a.prefault == b.prefault && a.lock == b.lock && a.numa_node == b.numa_node;
+    }
+};
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include "order_book_types.hpp"
+#include "page_allocator.hpp"
+
+// true if price a is strictly better than b for an order resting on side S
+template <Side S>
+constexpr bool better_price(Price a, Price b) {
+    return S == Side::Buy ? a > b : a < b;
+}
+
+template <Side S>
+struct BetterPrice {
+    constexpr bool operator()(Price a, Price b) const { return better_price<S>(a, b); }
+};
+
+// band of prices held in a flat array, anything outside goes to the fallback
+struct LadderConfig {
+    Price base {0};
+    uint32_t band {0};
+    // placement of the flat level array
+    MemoryPolicy memory {};
+};
+
+// Ladder interface (one instance per side), levels are visited best to worst
+//   Level& operator[](Price)   find or create level
+//   Level* find(Price)         nullptr if level does not exist
+//   Level* best(Price& out)    best existing level, nullptr if side is empty
+//   Level* next(Price& p)      best level strictly worse than p, updates p, nullptr if none
+//   void erase(Price)          remove level
+//   for_each(f(Price, const Level&))
+//   size_t bytes()             memory held by the ladder itself, not by what the levels point to
+// find, best and next also have const overloads
+
+// tree of levels, every new price is a node allocation
+template <class Level, Side S>
+class MapLadder {
+    std::map<Price, Level, BetterPrice<S>> m_levels;
+
+    public:
+
+    static constexpr Side side = S;
+
+    explicit MapLadder(const LadderConfig& = {}) {}
+
+    Level& operator[](Price p) { return m_levels[p]; }
+
+    Level* find(Price p) {
+        auto it = m_levels.find(p);
+        return it == m_levels.end() ? nullptr : &it->second;
+    }
+
+    Level* best(Price& out) {
+        if (m_levels.empty()) return nullptr;
+        auto it = m_levels.begin();
+        out = it->first;
+        return &it->second;
+    }
+
+    Level* next(Price& p) {
+        auto it = m_levels.upper_bound(p);
+        if (it == m_levels.end()) return nullptr;
+        p = it->first;
+        return &it->second;
+    }
+
+    const Level* find(Price p) const { return const_cast<MapLadder*>(this)->find(p); }
+    const Level* best(Price& out) const { return const_cast<MapLadder*>(this)->best(out); }
+    const Level* next(Price& p) const { return const_cast<MapLadder*>(this)->next(p); }
+
+    void erase(Price p) { m_levels.erase(p); }
+
+    bool empty() const { return m_levels.empty(); }
+
+    // one tree node per level, the node header is three pointers and a colour
+    size_t bytes() const { return m_levels.size() * (sizeof(std::pair<const Price, Level>) + 4 * sizeof(void*)); }
+
+    template <class F>
+    void for_each(F&& f) const {
+        for (const auto& [p, level] : m_levels) f(p, level);
+    }
+};
+
+// 3 level bitmap, bit i of a summary word is set if word i below it is non-zero
+// so lowest/highest set bit is one ctz/clz per level
+class OccupancyBitmap {
+    std::vector<uint64_t> m_l0;
+    std::vector<uint64_t> m_l1;
+    uint64_t m_l2 {0};
+
+    // bits strictly above / below position k of a word
+    static uint64_t above(size_t k) { return k >= 63 ? 0 : ~uint64_t{0} << (k + 1); }
+    static uint64_t below(size_t k) { return (uint64_t{1} << k) - 1; }
+
+    public:
+
+    static constexpr size_t max_bits = 64 * 64 * 64;
+
+    explicit OccupancyBitmap(size_t n_bits):
+    m_l0((n_bits + 63) / 64),
+    m_l1((m_l0.size() + 63) / 64)
+    {
+        if (n_bits > max_bits) throw std::invalid_argument("OccupancyBitmap: too many bits");
+    }
+
+    bool test(size_t i) const { return (m_l0[i >> 6] >> (i & 63)) & 1; }
+
+    void set(size_t i) {
+        m_l0[i >> 6] |= uint64_t{1} << (i & 63);
+        m_l1[i >> 12] |= uint64_t{1} << ((i >> 6) & 63);
+        m_l2 |= uint64_t{1} << (i >> 12);
+    }
+
+    void clear(size_t i) {
+        if ((m_l0[i >> 6] &= ~(uint64_t{1} << (i & 63))) != 0) return;
+        if ((m_l1[i >> 12] &= ~(uint64_t{1} << ((i >> 6) & 63))) != 0) return;
+        m_l2 &= ~(uint64_t{1} << (i >> 12));
+    }
+
+    bool lowest(size_t& out) const {
+        if (!m_l2) return false;
+        size_t w1 = std::countr_zero(m_l2);
+        size_t w0 = (w1 << 6) | std::countr_zero(m_l1[w1]);
+        out = (w0 << 6) | std::countr_zero(m_l0[w0]);
+        return true;
+    }
+
+    bool highest(size_t& out) const {
+        if (!m_l2) return false;
+        size_t w1 = 63 - std::countl_zero(m_l2);
+        size_t w0 = (w1 << 6) | (63 - std::countl_zero(m_l1[w1]));
+        out = (w0 << 6) | (63 - std::countl_zero(m_l0[w0]));
+        return true;
+    }
+
+    // lowest set bit above i
+    bool next_above(size_t i, size_t& out) const {
+        size_t j = i + 1;
+        if ((j >> 6) >= m_l0.size()) return false;
+        size_t w0 = j >> 6;
+        if (uint64_t bits = m_l0[w0] & (~uint64_t{0} << (j & 63))) {
+            out = (w0 << 6) | std::countr_zero(bits);
+            return true;
+        }
+        size_t w1 = w0 >> 6;
+        if (uint64_t bits = m_l1[w1] & above(w0 & 63)) {
+            w0 = (w1 << 6) | std::countr_zero(bits);
+        }
+        else {
+            uint64_t bits2 = m_l2 & above(w1);
+            if (!bits2) return false;
+            w1 = std::countr_zero(bits2);
+            w0 = (w1 << 6) | std::countr_zero(m_l1[w1]);
+        }
+        out = (w0 << 6) | std::countr_zero(m_l0[w0]);
+        return true;
+    }
+
+    // highest set bit below i
+    bool next_below(size_t i, size_t& out) const {
+        if (i == 0) return false;
+        size_t j = i - 1;
+        size_t w0 = j >> 6;
+        if (uint64_t bits = m_l0[w0] & (~uint64_t{0} >> (63 - (j & 63)))) {
+            out = (w0 << 6) | (63 - std::countl_zero(bits));
+            return true;
+        }
+        size_t w1 = w0 >> 6;
+        if (uint64_t bits = m_l1[w1] & below(w0 & 63)) {
+            w0 = (w1 << 6) | (63 - std::countl_zero(bits));
+        }
+        else {
+            uint64_t bits2 = m_l2 & below(w1);
+            if (!bits2) return false;
+            w1 = 63 - std::countl_zero(bits2);
+            w0 = (w1 << 6) | (63 - std::countl_zero(m_l1[w1]));
+        }
+        out = (w0 << 6) | (63 - std::countl_zero(m_l0[w0]));
+        return true;
+    }
+
+    size_t bytes() const { return (m_l0.capacity() + m_l1.capacity() + 1) * sizeof(uint64_t); }
+
+    // visit set bits, ascending or descending
+    template <class F>
+    void for_each(bool ascending, F&& f) const {
+        const size_t n = m_l0.size();
+        for (size_t k = 0; k < n; k++) {
+            size_t w = ascending ? k : n - 1 - k;
+            uint64_t bits = m_l0[w];
+            while (bits) {
+                size_t b = ascending ? std::countr_zero(bits) : 63 - std::countl_zero(bits);
+                bits &= ~(uint64_t{1} << b);
+                f((w << 6) | b);
+            }
+        }
+    }
+};
+
+// levels directly indexed by price - base over [base, base + band)
+// out of band prices fall back to a MapLadder
+template <class Level, Side S>
+class FlatLadder {
+    Price m_base;
+    uint32_t m_band;
+    std::vector<Level, PageAllocator<Level>> m_levels;
+    OccupancyBitmap m_occupied;
+    MapLadder<Level, S> m_overflow;
+
+    bool in_band(Price p) const { return p - m_base < m_band; }
+
+    public:
+
+    static constexpr Side side = S;
+
+    explicit FlatLadder(const LadderConfig& config = {}):
+    m_base(config.base),
+    m_band(config.band),
+    m_levels(config.band, PageAllocator<Level>(config.memory)),
+    m_occupied(config.band)
+    {}
+
+    Level& operator[](Price p) {
+        if (!in_band(p)) return m_overflow[p];
+        size_t i = p - m_base;
+        if (!m_occupied.test(i)) m_occupied.set(i);
+        return m_levels[i];
+    }
+
+    Level* find(Price p) {
+        if (!in_band(p)) return m_overflow.find(p);
+        size_t i = p - m_base;
+        return m_occupied.test(i) ? &m_levels[i] : nullptr;
+    }
+
+    Level* best(Price& out) {
+        size_t i;
+        bool has_band = (S == Side::Buy) ? m_occupied.highest(i) : m_occupied.lowest(i);
+        Price overflow_price;
+        Level* overflow_level = m_overflow.best(overflow_price);
+
+        if (has_band) {
+            Price band_price = m_base + static_cast<Price>(i);
+            if (!overflow_level || better_price<S>(band_price, overflow_price)) {
+                out = band_price;
+                return &m_levels[i];
+            }
+        }
+        if (overflow_level) out = overflow_price;
+        return overflow_level;
+    }
+
+    Level* next(Price& p) {
+        // next worse in band: after p if p is in band, the band best if p is better than the whole band
+        size_t i;
+        bool has_band;
+        if (in_band(p)) {
+            size_t from = p - m_base;
+            has_band = (S == Side::Buy) ? m_occupied.next_below(from, i) : m_occupied.next_above(from, i);
+        }
+        else if (better_price<S>(p, m_base)) {
+            has_band = (S == Side::Buy) ? m_occupied.highest(i) : m_occupied.lowest(i);
+        }
+        else {
+            has_band = false;
+        }
+
+        Price overflow_price = p;
+        Level* overflow_level = m_overflow.next(overflow_price);
+
+        if (has_band) {
+            Price band_price = m_base + static_cast<Price>(i);
+            if (!overflow_level || better_price<S>(band_price, overflow_price)) {
+                p = band_price;
+                return &m_levels[i];
+            }
+        }
+        if (overflow_level) p = overflow_price;
+        return overflow_level;
+    }
+
+    const Level* find(Price p) const { return const_cast<FlatLadder*>(this)->find(p); }
+    const Level* best(Price& out) const { return const_cast<FlatLadder*>(this)->best(out); }
+    const Level* next(Price& p) const { return const_cast<FlatLadder*>(this)->next(p); }
+
+    void erase(Price p) {
+        if (!in_band(p)) return m_overflow.erase(p);
+        size_t i = p - m_base;
+        m_levels[i].clear();
+        m_occupied.clear(i);
+    }
+
+    bool empty() const {
+        size_t i;
+        return !m_occupied.lowest(i) && m_overflow.empty();
+    }
+
+    size_t bytes() const { return m_levels.capacity() * sizeof(Level) + m_occupied.bytes() + m_overflow.bytes(); }
+
+    template <class F>
+    void for_each(F&& f) const {
+        // overflow prices are never in band, so they sort wholly before or after it
+        m_overflow.for_each([&](Price p, const Level& level) {
+            if (better_price<S>(p, m_base)) f(p, level);
+        });
+        m_occupied.for_each(S == Side::Sell, [&](size_t i) {
+            f(m_base + static_cast<Price>(i), m_levels[i]);
+        });
+        m_overflow.for_each([&](Price p, const Level& level) {
+            if (!better_price<S>(p, m_base)) f(p, level);
+        });
+    }
+};
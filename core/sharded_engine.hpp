@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "order_book.hpp"
+#include "spsc_ring.hpp"
+#include "tsc_clock.hpp"
+
+// pin the calling thread to one core, false if the core does not exist or the call is refused
+inline bool pin_this_thread(int core) {
+    if (core < 0 || core >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+struct EngineConfig {
+    size_t n_shards {1};
+    // gateway threads, each gets its own ring into every shard
+    size_t n_producers {1};
+    size_t ring_capacity {1 << 14};
+    // core for shard i's thread is cores[i], unpinned if missing or negative
+    std::vector<int> cores {};
+};
+
+// instruments are spread over shards by id, shard = instrument % n_shards
+// each shard has one consumer thread that owns its books outright, so a book is only ever
+// touched by one thread and an instrument's events are applied in the order its producer sent them
+// rings of different producers are interleaved by polling, so an instrument's order is only
+// deterministic if all of its events come through one producer
+// good till time orders expire on event time inside the book (see OrderBook::on_new), so
+// expire_time is on the producers' timestamp_in clock and expiry replays from a journal
+// Book is an OrderBook, one per instrument, registered with add_instrument before start
+template <class Book>
+class ShardedEngine {
+    struct Shard {
+        std::vector<std::unique_ptr<SpscRing<Event>>> rings; // one per producer
+        // sorted by instrument id, books[i] belongs to instruments[i], built from configs[i]
+        // by the shard thread once pinned, so their memory is first touched on the shard's node
+        std::vector<InstrumentId> instruments;
+        std::vector<BookConfig> configs;
+        std::vector<std::unique_ptr<Book>> books;
+        std::thread thread;
+        LatencyHistogram latency_ns;
+        std::atomic<uint64_t> processed {0};
+        std::atomic<uint64_t> dropped {0}; // events for instruments never registered
+        std::atomic<bool> ready {false}; // books built, or build failed with error set
+        std::exception_ptr error;
+        bool pinned {false};
+    };
+
+    EngineConfig m_config;
+    const TscClock& m_clock;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::atomic<bool> m_stop {false};
+    bool m_running {false};
+    bool m_started {false}; // instruments are fixed from the first start on
+
+    // binary search of the shard's instruments, nullptr if not registered
+    static Book* find_book(Shard& shard, InstrumentId instrument) {
+        auto it = std::lower_bound(shard.instruments.begin(), shard.instruments.end(), instrument);
+        if (it == shard.instruments.end() || *it != instrument) return nullptr;
+        return shard.books[it - shard.instruments.begin()].get();
+    }
+
+    // pin before anything is allocated, then build the books on the first start, start() waits on ready
+    bool prepare(Shard& shard, int core) {
+        shard.pinned = pin_this_thread(core);
+        try {
+            if (shard.books.empty()) {
+                for (const BookConfig& config : shard.configs) shard.books.push_back(std::make_unique<Book>(config));
+            }
+        }
+        catch (...) {
+            shard.books.clear();
+            shard.error = std::current_exception();
+        }
+        shard.ready.store(true, std::memory_order_release);
+        return !shard.error;
+    }
+
+    void run(Shard& shard, int core) {
+        constexpr size_t batch_size = 64;
+        if (!prepare(shard, core)) return;
+        while (true) {
+            bool idle = true;
+            // rings are polled in a fixed order, each drained a batch at a time
+            for (auto& ring : shard.rings) {
+                std::span<Event> batch = ring->peek_n(batch_size);
+                if (batch.empty()) continue;
+                idle = false;
+
+                Timestamp now = m_clock.now();
+                for (const Event& e : batch) shard.latency_ns.record(now > e.timestamp_in ? now - e.timestamp_in : 0);
+                // each run of consecutive events for one instrument goes to its book in one call
+                uint64_t dropped {0};
+                for (size_t i = 0, j; i < batch.size(); i = j) {
+                    for (j = i + 1; j < batch.size() && batch[j].instrument == batch[i].instrument; j++) {}
+                    if (Book* book = find_book(shard, batch[i].instrument)) book->on_batch(batch.subspan(i, j - i), now);
+                    else dropped += j - i;
+                }
+                if (dropped) shard.dropped.store(shard.dropped.load(std::memory_order_relaxed) + dropped, std::memory_order_relaxed);
+                shard.processed.store(shard.processed.load(std::memory_order_relaxed) + batch.size(), std::memory_order_relaxed);
+                ring->release(batch.size());
+            }
+            if (idle) {
+                if (m_stop.load(std::memory_order_acquire)) {
+                    bool drained = true;
+                    for (auto& ring : shard.rings) drained &= ring->empty();
+                    if (drained) return;
+                }
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    public:
+
+    ShardedEngine(const EngineConfig& config, const TscClock& clock):
+    m_config(config),
+    m_clock(clock)
+    {
+        if (config.n_shards == 0 || config.n_producers == 0) throw std::invalid_argument("ShardedEngine: need at least one shard and producer");
+        for (size_t s = 0; s < config.n_shards; s++) {
+            auto shard = std::make_unique<Shard>();
+            for (size_t p = 0; p < config.n_producers; p++) shard->rings.push_back(std::make_unique<SpscRing<Event>>(config.ring_capacity));
+            m_shards.push_back(std::move(shard));
+        }
+    }
+
+    ShardedEngine(const ShardedEngine&) = delete;
+    ShardedEngine& operator=(const ShardedEngine&) = delete;
+
+    ~ShardedEngine() { stop(); }
+
+    // register an instrument, only before the first start, its book is built by start so its
+    // memory is allocated up front on the shard's core and not on the first event
+    void add_instrument(InstrumentId instrument, const BookConfig& book_config = {}) {
+        if (m_started) throw std::logic_error("ShardedEngine: add_instrument after start");
+        Shard& shard = *m_shards[shard_of(instrument)];
+        auto it = std::lower_bound(shard.instruments.begin(), shard.instruments.end(), instrument);
+        if (it != shard.instruments.end() && *it == instrument) throw std::invalid_argument("ShardedEngine: instrument already added");
+        size_t i = it - shard.instruments.begin();
+        shard.instruments.insert(it, instrument);
+        shard.configs.insert(shard.configs.begin() + i, book_config);
+    }
+
+    // start the shard threads, each pins itself to its configured core and then builds its books,
+    // returns once every book exists, rethrows a failed build after joining the threads
+    void start() {
+        if (m_running) return;
+        m_stop.store(false, std::memory_order_relaxed);
+        m_started = true;
+        for (size_t s = 0; s < m_shards.size(); s++) {
+            Shard& shard = *m_shards[s];
+            int core = s < m_config.cores.size() ? m_config.cores[s] : -1;
+            shard.ready.store(false, std::memory_order_relaxed);
+            shard.error = nullptr;
+            shard.thread = std::thread([this, &shard, core] { run(shard, core); });
+        }
+        m_running = true;
+        std::exception_ptr error;
+        for (auto& shard : m_shards) {
+            while (!shard->ready.load(std::memory_order_acquire)) std::this_thread::yield();
+            if (shard->error && !error) error = shard->error;
+        }
+        if (error) {
+            stop();
+            std::rethrow_exception(error);
+        }
+    }
+
+    // apply everything already submitted, then join the shard threads
+    void stop() {
+        if (!m_running) return;
+        m_stop.store(true, std::memory_order_release);
+        for (auto& shard : m_shards) shard->thread.join();
+        m_running = false;
+    }
+
+    size_t shard_of(InstrumentId instrument) const { return instrument % m_config.n_shards; }
+
+    // producer p only, false if its ring into the shard is full
+    // events for an instrument that was never added are dropped by the shard, see dropped()
+    bool try_submit(size_t producer, const Event& e) {
+        return m_shards[shard_of(e.instrument)]->rings[producer]->try_push(e);
+    }
+
+    // spins while the ring is full
+    void submit(size_t producer, const Event& e) {
+        SpscRing<Event>& ring = *m_shards[shard_of(e.instrument)]->rings[producer];
+        Event* slot;
+        while (!(slot = ring.claim())) {}
+        new (slot) Event(e);
+        ring.publish();
+    }
+
+    size_t n_shards() const { return m_shards.size(); }
+
+    uint64_t processed(size_t shard) const { return m_shards[shard]->processed.load(std::memory_order_relaxed); }
+    uint64_t dropped(size_t shard) const { return m_shards[shard]->dropped.load(std::memory_order_relaxed); }
+    bool pinned(size_t shard) const { return m_shards[shard]->pinned; }
+
+    // merged over shards, read once stopped
+    void latency(LatencyHistogram& out) const {
+        for (const auto& shard : m_shards) out.merge(shard->latency_ns);
+    }
+
+    // nullptr if the instrument was never added or its book is not built yet, only safe once stopped
+    Book* book(InstrumentId instrument) {
+        Shard& shard = *m_shards[shard_of(instrument)];
+        return shard.books.empty() ? nullptr : find_book(shard, instrument);
+    }
+};
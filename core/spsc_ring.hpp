@@ -1,50 +1,170 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
 #include <new>
+#include <span>
 
-template <class T>
+#include "page_allocator.hpp"
+#include "wait_strategy.hpp"
+
+// CacheIndices: each side keeps a private copy of the other side's index and only
+// reloads the shared atomic when that copy says the ring looks full (producer) or empty (consumer)
+// Wait is how wait_n idles while the ring is empty (see wait_strategy.hpp), the producer
+// notifies it on every publish, which compiles to nothing for the spinning strategies
+template <class T, bool CacheIndices = false, class Wait = BusySpinWait>
 class SpscRing {
     static constexpr size_t cacheLineSize = 64;
     
-    // test performance with and without aligning
-    alignas(cacheLineSize) std::atomic<size_t> m_head; // alignas(cacheLineSize)
-    alignas(cacheLineSize) std::atomic<size_t> m_tail; // alignas(cacheLineSize)
     const size_t m_capacity, m_mask;
+    PageAllocator<T> m_alloc;
     T* m_buffer;
 
+    // test performance with and without aligning
+    alignas(cacheLineSize) std::atomic<size_t> m_head {0}; // alignas(cacheLineSize)
+    alignas(cacheLineSize) std::atomic<size_t> m_tail {0}; // alignas(cacheLineSize)
+    alignas(cacheLineSize) size_t m_head_cache {0}; // consumer only
+    alignas(cacheLineSize) size_t m_tail_cache {0}; // producer only
+    [[no_unique_address]] Wait m_wait;
+
+    // free slots seen by the producer, reloads the consumer index if fewer than wanted
+    size_t free_slots(size_t head, size_t wanted) {
+        if constexpr (CacheIndices) {
+            size_t free = (m_tail_cache - head - 1) & m_mask;
+            if (free >= wanted) return free;
+            m_tail_cache = m_tail.load(std::memory_order_acquire);
+            return (m_tail_cache - head - 1) & m_mask;
+        }
+        return (m_tail.load(std::memory_order_acquire) - head - 1) & m_mask;
+    }
+
+    // filled slots seen by the consumer, reloads the producer index if fewer than wanted
+    size_t used_slots(size_t tail, size_t wanted) {
+        if constexpr (CacheIndices) {
+            size_t used = (m_head_cache - tail) & m_mask;
+            if (used >= wanted) return used;
+            m_head_cache = m_head.load(std::memory_order_acquire);
+            return (m_head_cache - tail) & m_mask;
+        }
+        return (m_head.load(std::memory_order_acquire) - tail) & m_mask;
+    }
+
     public:
     
-    explicit SpscRing(size_t capacity): 
+    // memory places the slot buffer, see page_allocator.hpp
+    explicit SpscRing(size_t capacity, const MemoryPolicy& memory = {}): 
     m_capacity(capacity), 
     m_mask(capacity - 1), 
-    m_buffer(static_cast<T*>(::operator new[](capacity * sizeof(T)))) 
+    m_alloc(memory),
+    m_buffer(m_alloc.allocate(capacity)) 
     {}
 
     ~SpscRing() {
         for (size_t i = m_tail.load(); i != m_head.load(); i = (i+1) & m_mask) m_buffer[i].~T();
-        ::operator delete[](m_buffer);
+        m_alloc.deallocate(m_buffer, m_capacity);
     }
 
     bool try_push(const T& x) {
         size_t head = m_head.load(std::memory_order_relaxed);
         size_t next = (head+1) & m_mask;
-        if (next == m_tail.load(std::memory_order_acquire)) return false;
+        if (!free_slots(head, 1)) return false;
         new (&m_buffer[head]) T(x);
         m_head.store(next, std::memory_order_release);
+        m_wait.notify();
         return true;
     }
 
     bool try_pop(T& out) {
         size_t tail = m_tail.load(std::memory_order_relaxed);
-        if (tail == m_head.load(std::memory_order_acquire)) return false;
+        if (!used_slots(tail, 1)) return false;
         out = std::move(m_buffer[tail]);
         m_buffer[tail].~T();
         m_tail.store((tail+1) & m_mask, std::memory_order_release);
         return true;
     }
 
+    // push up to n items with a single head publish, returns number pushed
+    size_t try_push_n(const T* xs, size_t n) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t free = free_slots(head, n);
+        if (n > free) n = free;
+        for (size_t i = 0; i < n; i++) new (&m_buffer[(head + i) & m_mask]) T(xs[i]);
+        if (n) {
+            m_head.store((head + n) & m_mask, std::memory_order_release);
+            m_wait.notify();
+        }
+        return n;
+    }
+
+    // pop up to n items with a single tail publish, returns number popped
+    size_t try_pop_n(T* out, size_t n) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t avail = used_slots(tail, n);
+        if (n > avail) n = avail;
+        for (size_t i = 0; i < n; i++) {
+            T& slot = m_buffer[(tail + i) & m_mask];
+            out[i] = std::move(slot);
+            slot.~T();
+        }
+        if (n) m_tail.store((tail + n) & m_mask, std::memory_order_release);
+        return n;
+    }
+
+    // zero copy producer side: construct the payload in the claimed slot, then publish it
+    // returns raw storage for the next slot, nullptr if the ring is full
+    T* claim() {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (!free_slots(head, 1)) return nullptr;
+        return &m_buffer[head];
+    }
+
+    // make the slot returned by the last claim() visible, it must hold a constructed T
+    void publish() {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        m_head.store((head+1) & m_mask, std::memory_order_release);
+        m_wait.notify();
+    }
+
+    // zero copy consumer side: read the oldest slot in place, then release it
+    // returns nullptr if the ring is empty
+    T* peek() {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (!used_slots(tail, 1)) return nullptr;
+        return &m_buffer[tail];
+    }
+
+    // up to n filled slots in place, stops early at the end of the buffer so the span is contiguous
+    std::span<T> peek_n(size_t n) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t avail = used_slots(tail, n);
+        if (n > avail) n = avail;
+        if (n > m_capacity - tail) n = m_capacity - tail;
+        return {&m_buffer[tail], n};
+    }
+
+    // peek_n that first waits, per the Wait strategy, until a slot is filled or done() is true
+    // empty only when done() and nothing is left, whoever makes done() true calls notify()
+    template <class Done>
+    std::span<T> wait_n(size_t n, Done&& done) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        m_wait.wait([&] { return used_slots(tail, 1) > 0 || done(); });
+        return peek_n(n);
+    }
+
+    // wake a consumer blocked in wait_n, for conditions outside the ring such as shutdown
+    void notify() { m_wait.notify(); }
+
+    // destroy and hand back the n oldest slots, previously returned by peek/peek_n
+    void release(size_t n = 1) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < n; i++) m_buffer[(tail + i) & m_mask].~T();
+        m_tail.store((tail + n) & m_mask, std::memory_order_release);
+    }
+
     bool empty() {
         return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
     }
-};
\ No newline at end of file
+};
+
+template <class T>
+using CachedSpscRing = SpscRing<T, true>;
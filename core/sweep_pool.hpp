@@ -0,0 +1,262 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "order_pool.hpp"
+
+// number of leading quantities fully covered by remaining, their sum is taken off remaining
+// quantities are non negative, a zero is a cancelled slot and is always covered
+// with SSE2 four makers are decided per step: an in register prefix sum compared against
+// remaining, the first lane past it is where the partial fill lands
+inline size_t covered_prefix(const int32_t* quantities, size_t n, int32_t& remaining) {
+    size_t i {0};
+#if defined(__SSE2__)
+    // four quantities under 2^29 cannot overflow the lane sums, anything bigger takes the scalar step
+    const __m128i big = _mm_set1_epi32((1 << 29) - 1);
+    while (i + 4 <= n) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i));
+        if (_mm_movemask_epi8(_mm_cmpgt_epi32(v, big))) break;
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+        int past = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, _mm_set1_epi32(remaining))));
+        if (past == 0) {
+            remaining -= _mm_cvtsi128_si32(_mm_shuffle_epi32(v, 0xff));
+            i += 4;
+            continue;
+        }
+        // prefix sums only grow, so the lanes past remaining are a suffix of the block
+        int covered = __builtin_ctz(past);
+        alignas(16) int32_t prefix[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(prefix), v);
+        if (covered) remaining -= prefix[covered - 1];
+        return i + covered;
+    }
+#endif
+    for (; i < n && quantities[i] <= remaining; i++) remaining -= quantities[i];
+    return i;
+}
+
+// level FIFO as three parallel arrays, a sweep reads handles, ids and quantities front to back
+// cancels leave a zero quantity hole behind, filled makers are popped by moving head
+// SweepOrderPool compacts the queue once holes and popped slots outnumber live ones
+struct SweepQueue {
+    // an emptied level keeps a buffer this small for reuse, anything bigger is given back
+    static constexpr size_t kept_slots = 64;
+
+    std::vector<OrderHandle> handles;
+    std::vector<OrderId> order_ids;
+    std::vector<int32_t> quantities;
+    uint32_t head {0}; // first slot not yet popped
+    uint32_t live {0}; // slots holding a resting order
+
+    bool empty() const { return live == 0; }
+
+    void clear() {
+        if (handles.capacity() > kept_slots) {
+            handles = {};
+            order_ids = {};
+            quantities = {};
+        }
+        handles.clear();
+        order_ids.clear();
+        quantities.clear();
+        head = live = 0;
+    }
+
+    // popped slots plus holes left by cancels
+    size_t dead() const { return handles.size() - live; }
+};
+
+// SoaOrderPool columns for the cold fields, quantities and FIFO order live in the level's SweepQueue
+// a large aggressor fills a whole run of makers per kernel step and gets it back as one run,
+// whose ids are read in order from the queue and whose slots go back on the free stack in one pass
+class SweepOrderPool {
+    template <class T>
+    using Column = std::vector<T, PageAllocator<T>>;
+
+    Column<OrderId> m_order_id;
+    Column<Price> m_price;
+    Column<Side> m_side;
+    Column<uint64_t> m_seq_new;
+    Column<TWHandle> m_timer;
+    Column<uint32_t> m_slot; // index into the level's SweepQueue
+    Column<OrderHandle> m_free; // free slots, a stack of m_n_free handles
+    size_t m_n_free {0};
+
+    public:
+
+    using Queue = SweepQueue;
+
+    explicit SweepOrderPool(size_t capacity, const MemoryPolicy& memory = {}):
+    m_order_id(PageAllocator<OrderId>(memory)),
+    m_price(PageAllocator<Price>(memory)),
+    m_side(PageAllocator<Side>(memory)),
+    m_seq_new(PageAllocator<uint64_t>(memory)),
+    m_timer(PageAllocator<TWHandle>(memory)),
+    m_slot(PageAllocator<uint32_t>(memory)),
+    m_free(PageAllocator<OrderHandle>(memory))
+    {
+        resize(capacity);
+        for (size_t i = capacity; i-- > 0;) free(static_cast<OrderHandle>(i));
+    }
+
+    OrderHandle alloc(const Order& order) {
+        if (m_n_free == 0) {
+            resize(m_slot.size() + 1);
+            free(static_cast<OrderHandle>(m_slot.size() - 1));
+        }
+        OrderHandle h = m_free[--m_n_free];
+        m_order_id[h] = order.order_id;
+        m_price[h] = order.price;
+        m_side[h] = order.side;
+        m_seq_new[h] = order.seq_new;
+        m_timer[h] = TWHandle{};
+        return h;
+    }
+
+    void free(OrderHandle h) { m_free[m_n_free++] = h; }
+
+    // a whole run, holes are skipped without a branch
+    void free(std::span<const OrderHandle> handles) {
+        for (OrderHandle h : handles) {
+            m_free[m_n_free] = h;
+            m_n_free += h != null_handle;
+        }
+    }
+
+    OrderId order_id(OrderHandle h) const { return m_order_id[h]; }
+    Side side(OrderHandle h) const { return m_side[h]; }
+    Price price(OrderHandle h) const { return m_price[h]; }
+    uint64_t seq_new(OrderHandle h) const { return m_seq_new[h]; }
+    int32_t& quantity(SweepQueue& q, OrderHandle h) { return q.quantities[m_slot[h]]; }
+    int32_t quantity(const SweepQueue& q, OrderHandle h) const { return q.quantities[m_slot[h]]; }
+    TWHandle& timer(OrderHandle h) { return m_timer[h]; }
+    TWHandle timer(OrderHandle h) const { return m_timer[h]; }
+
+    size_t live() const { return m_slot.size() - m_n_free; }
+    size_t capacity() const { return m_slot.size(); }
+
+    size_t bytes() const {
+        return m_order_id.capacity() * sizeof(OrderId) + m_price.capacity() * sizeof(Price)
+            + m_side.capacity() * sizeof(Side) + m_seq_new.capacity() * sizeof(uint64_t)
+            + m_timer.capacity() * sizeof(TWHandle) + m_slot.capacity() * sizeof(uint32_t)
+            + m_free.capacity() * sizeof(OrderHandle);
+    }
+    size_t bytes(const SweepQueue& q) const {
+        return q.handles.capacity() * sizeof(OrderHandle) + q.order_ids.capacity() * sizeof(OrderId)
+            + q.quantities.capacity() * sizeof(int32_t);
+    }
+    size_t dead(const SweepQueue& q) const { return q.dead(); }
+
+    void push_back(SweepQueue& q, OrderHandle h, int32_t quantity) {
+        m_slot[h] = static_cast<uint32_t>(q.handles.size());
+        q.handles.push_back(h);
+        q.order_ids.push_back(m_order_id[h]);
+        q.quantities.push_back(quantity);
+        q.live++;
+    }
+
+    void unlink(SweepQueue& q, OrderHandle h) {
+        uint32_t slot = m_slot[h];
+        q.handles[slot] = null_handle;
+        q.quantities[slot] = 0;
+        if (--q.live == 0) q.clear();
+        else compact_if_sparse(q);
+    }
+
+    // one kernel pass decides every maker filled in full, the whole run is handed over in one
+    // call straight out of the queue arrays and popped in one step
+    template <class Run, class Partial>
+    int32_t fill(SweepQueue& q, int32_t quantity, Run&& run, Partial&& partial) {
+        size_t n = q.handles.size() - q.head;
+        const OrderHandle* handles = q.handles.data() + q.head;
+        const OrderId* order_ids = q.order_ids.data() + q.head;
+        int32_t* quantities = q.quantities.data() + q.head;
+
+        int32_t remaining = quantity;
+        size_t covered = covered_prefix(quantities, n, remaining);
+
+        if (covered) {
+            uint32_t holes {0};
+            for (size_t i = 0; i < covered; i++) holes += handles[i] == null_handle;
+            q.live -= static_cast<uint32_t>(covered) - holes;
+            run(std::span<const OrderHandle>(handles, covered), std::span<const OrderId>(order_ids, covered),
+                std::span<const int32_t>(quantities, covered));
+        }
+        if (covered < n && remaining > 0) {
+            quantities[covered] -= remaining;
+            partial(handles[covered], remaining);
+            remaining = 0;
+        }
+        pop_front(q, covered);
+        return quantity - remaining;
+    }
+
+    template <class F>
+    void for_each(const SweepQueue& q, F&& f) const {
+        for (size_t i = q.head; i < q.handles.size(); i++) {
+            OrderHandle h = q.handles[i];
+            if (h != null_handle) f(Order{q.order_ids[i], m_side[h], m_price[h], q.quantities[i], m_seq_new[h]});
+        }
+    }
+
+    template <class F>
+    void for_each_handle(const SweepQueue& q, F&& f) const {
+        for (size_t i = q.head; i < q.handles.size(); i++) {
+            if (q.handles[i] != null_handle) f(q.handles[i]);
+        }
+    }
+
+    private:
+
+    void pop_front(SweepQueue& q, size_t n) {
+        q.head += static_cast<uint32_t>(n);
+        if (q.live == 0) q.clear();
+        else compact_if_sparse(q);
+    }
+
+    // slide the live slots down over the holes and the popped prefix once they are the majority
+    // each compaction is paid for by at least as many earlier cancels or fills, so the cost per
+    // event is O(1) amortised and a queue never holds more than twice its live orders (plus slack)
+    void compact_if_sparse(SweepQueue& q) {
+        size_t dead = q.dead();
+        if (dead < SweepQueue::kept_slots || dead <= q.live) return;
+        uint32_t out {0};
+        for (size_t i = q.head; i < q.handles.size(); i++) {
+            OrderHandle h = q.handles[i];
+            if (h == null_handle) continue;
+            q.handles[out] = h;
+            q.order_ids[out] = q.order_ids[i];
+            q.quantities[out] = q.quantities[i];
+            m_slot[h] = out++;
+        }
+        q.handles.resize(out);
+        q.order_ids.resize(out);
+        q.quantities.resize(out);
+        q.head = 0;
+        // a queue that drained from a deep peak gives the buffer back too
+        if (q.handles.capacity() > 4 * (out + SweepQueue::kept_slots)) {
+            q.handles.shrink_to_fit();
+            q.order_ids.shrink_to_fit();
+            q.quantities.shrink_to_fit();
+        }
+    }
+
+    void resize(size_t n) {
+        m_order_id.resize(n);
+        m_price.resize(n);
+        m_side.resize(n);
+        m_seq_new.resize(n);
+        m_timer.resize(n);
+        m_slot.resize(n);
+        // one spare entry, free(span) writes one past the top for a hole
+        m_free.resize(n + 1);
+    }
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "order_book_types.hpp"
+#include "spsc_ring.hpp"
+
+// TradeSink interface, owned by the OrderBook
+//   void begin()                  an aggressor event starts matching
+//   void on_trade(const Trade&)   one fill, stamped with the caller's timestamp for the event
+//   void on_trades(std::span<const Trade>)
+//                                 a run of fills in order, makers a sweep took off a level in full
+
+// collects every fill, the caller drains or clears trades
+struct VectorTradeSink {
+    std::vector<Trade> trades;
+
+    void begin() {}
+    void on_trade(const Trade& t) { trades.push_back(t); }
+    void on_trades(std::span<const Trade> ts) { trades.insert(trades.end(), ts.begin(), ts.end()); }
+};
+
+// hands each fill straight to f, inlined when F is a lambda or function object
+template <class F>
+class CallbackTradeSink {
+    F m_f;
+
+    public:
+
+    explicit CallbackTradeSink(F f = {}): m_f(std::move(f)) {}
+
+    void begin() {}
+    void on_trade(const Trade& t) { m_f(t); }
+    void on_trades(std::span<const Trade> ts) { for (const Trade& t : ts) m_f(t); }
+
+    F& callback() { return m_f; }
+};
+
+// fills of the current aggressor event only, reset on begin()
+// N must cover the deepest sweep, anything past it is counted in dropped()
+template <size_t N>
+class BufferTradeSink {
+    std::array<Trade, N> m_trades;
+    size_t m_size {0};
+    size_t m_dropped {0};
+
+    public:
+
+    void begin() { m_size = 0; }
+
+    void on_trade(const Trade& t) {
+        if (m_size < N) m_trades[m_size++] = t;
+        else m_dropped++;
+    }
+
+    void on_trades(std::span<const Trade> ts) {
+        size_t n = std::min(ts.size(), N - m_size);
+        std::copy_n(ts.begin(), n, m_trades.begin() + m_size);
+        m_size += n;
+        m_dropped += ts.size() - n;
+    }
+
+    std::span<const Trade> trades() const { return {m_trades.data(), m_size}; }
+    size_t dropped() const { return m_dropped; }
+};
+
+// order sensitive 64 bit hash of the fill stream, two runs over the same events hash equal
+// iff they produced the same fills in the same order, timestamps are left out
+class HashingTradeSink {
+    uint64_t m_hash {0x9e3779b97f4a7c15};
+    size_t m_count {0};
+
+    void mix(uint64_t v) {
+        m_hash ^= v * 0xbf58476d1ce4e5b9;
+        m_hash = ((m_hash << 31) | (m_hash >> 33)) * 0x94d049bb133111eb;
+    }
+
+    public:
+
+    void begin() {}
+
+    void on_trade(const Trade& t) {
+        mix(t.seller_id);
+        mix(t.buyer_id);
+        mix((uint64_t{t.price} << 32) | static_cast<uint32_t>(t.quantity));
+        m_count++;
+    }
+
+    void on_trades(std::span<const Trade> ts) { for (const Trade& t : ts) on_trade(t); }
+
+    uint64_t hash() const { return m_hash; }
+    size_t count() const { return m_count; }
+};
+
+// publishes each fill into a ring for a downstream consumer, spins while the ring is full
+template <class Ring = SpscRing<Trade>>
+class RingTradeSink {
+    Ring* m_ring;
+
+    public:
+
+    explicit RingTradeSink(Ring& ring): m_ring(&ring) {}
+
+    void begin() {}
+
+    void on_trade(const Trade& t) {
+        Trade* slot;
+        while (!(slot = m_ring->claim())) {}
+        new (slot) Trade(t);
+        m_ring->publish();
+    }
+
+    // one publish per run where the ring takes a batch
+    void on_trades(std::span<const Trade> ts) {
+        if constexpr (requires { m_ring->try_push_n(ts.data(), ts.size()); }) {
+            for (size_t i = 0; i < ts.size();) i += m_ring->try_push_n(ts.data() + i, ts.size() - i);
+        }
+        else {
+            for (const Trade& t : ts) on_trade(t);
+        }
+    }
+};
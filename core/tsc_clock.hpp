@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// ns timestamps from the cycle counter, calibrated once against steady_clock
+// now() is one rdtsc plus a multiply, readings are on the steady_clock epoch
+// assumes an invariant TSC synchronised across cores, falls back to steady_clock elsewhere
+class TscClock {
+    static constexpr int shift = 32;
+
+    uint64_t m_base_ticks;
+    uint64_t m_base_ns;
+    uint64_t m_mult; // ns per tick << shift
+
+    static uint64_t steady_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    public:
+
+    static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return steady_ns();
+#endif
+    }
+
+    // spins for the calibration window
+    explicit TscClock(std::chrono::nanoseconds calibration = std::chrono::milliseconds(10)) {
+        uint64_t ns0 = steady_ns();
+        uint64_t t0 = ticks();
+        uint64_t ns1;
+        while ((ns1 = steady_ns()) - ns0 < static_cast<uint64_t>(calibration.count())) {}
+        uint64_t t1 = ticks();
+
+        m_mult = t1 > t0 ? ((ns1 - ns0) << shift) / (t1 - t0) : uint64_t{1} << shift;
+        m_base_ticks = t1;
+        m_base_ns = ns1;
+    }
+
+    // a counter behind the calibration base (another socket's unsynchronised TSC) reads as the
+    // base time rather than wrapping to the far future
+    uint64_t to_ns(uint64_t t) const {
+        if (t < m_base_ticks) return m_base_ns;
+        return m_base_ns + static_cast<uint64_t>((static_cast<unsigned __int128>(t - m_base_ticks) * m_mult) >> shift);
+    }
+
+    uint64_t now() const { return to_ns(ticks()); }
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// spin loop hint, lets the sibling hyperthread run and avoids the memory order flush on exit
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+// WaitStrategy interface, one waiting thread and one notifying thread
+//   template <class F> void wait(F&& ready)   returns once ready() is true
+//   void notify()                              call after making something ready
+
+// lowest latency, burns the core
+struct BusySpinWait {
+    template <class F>
+    void wait(F&& ready) { while (!ready()) {} }
+    void notify() {}
+};
+
+// dedicated cores, same latency as a busy spin but friendlier to the sibling hyperthread
+struct PauseSpinWait {
+    template <class F>
+    void wait(F&& ready) { while (!ready()) cpu_relax(); }
+    void notify() {}
+};
+
+// shared cores, gives the time slice away on every miss
+struct YieldWait {
+    template <class F>
+    void wait(F&& ready) { while (!ready()) std::this_thread::yield(); }
+    void notify() {}
+};
+
+// spins, then yields, then sleeps on a futex until notified
+// notify is a fence and one load unless the waiter is actually asleep
+class BackoffWait {
+    static constexpr int spin_limit = 1 << 10;
+    static constexpr int yield_limit = 1 << 4;
+
+    alignas(64) std::atomic<uint32_t> m_epoch {0};
+    std::atomic<uint32_t> m_sleeping {0};
+
+    static void futex_wait(std::atomic<uint32_t>& word, uint32_t expected) {
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+    }
+
+    static void futex_wake(std::atomic<uint32_t>& word) {
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+    public:
+
+    template <class F>
+    void wait(F&& ready) {
+        for (int i = 0; i < spin_limit; i++) {
+            if (ready()) return;
+            cpu_relax();
+        }
+        for (int i = 0; i < yield_limit; i++) {
+            if (ready()) return;
+            std::this_thread::yield();
+        }
+        while (true) {
+            uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+            // announce the sleep before the last check, pairs with the fence in notify
+            m_sleeping.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ready()) break;
+            futex_wait(m_epoch, epoch);
+            if (ready()) break;
+        }
+        m_sleeping.store(0, std::memory_order_relaxed);
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleeping.load(std::memory_order_relaxed)) {
+            m_epoch.fetch_add(1, std::memory_order_release);
+            futex_wake(m_epoch);
+        }
+    }
+};